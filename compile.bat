@@ -1,3 +1,5 @@
 C:\VulkanSDK\1.3.250.0\Bin\glslc.exe shaders\shader.vert -o shaders\shader.vert.spv
 C:\VulkanSDK\1.3.250.0\Bin\glslc.exe shaders\shader.frag -o shaders\shader.frag.spv
+C:\VulkanSDK\1.3.250.0\Bin\glslc.exe shaders\terrain.vert -o shaders\terrain.vert.spv
+C:\VulkanSDK\1.3.250.0\Bin\glslc.exe shaders\terrain.frag -o shaders\terrain.frag.spv
 pause
\ No newline at end of file
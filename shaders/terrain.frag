@@ -0,0 +1,58 @@
+#version 450
+
+layout (location = 0) in vec3 fragNormal;
+layout (location = 1) in float fragHeight;
+layout (location = 2) flat in uint fragMaterial;
+layout (location = 3) in float fragOcclusion;
+layout (location = 4) in vec2 fragLight;	// sky and block light, 0 to 1
+
+layout (location = 0) out vec4 outColour;
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionView;
+	vec3 lightDirection;
+} ubo;
+
+// TerrainMaterialUbo
+layout (set = 1, binding = 0) uniform MaterialUbo {
+	vec4 stoneColour;
+	vec4 grassColour;
+	vec4 snowColour;
+	float snowMinHeight;
+	float snowMinNormalY;
+	float grassMinNormalY;
+} material;
+
+const float ambient = 0.3;
+const vec3 blockLightColour = vec3(1.0, 0.8, 0.6);
+
+// TerrainMaterial
+const uint materialShaded = 0;
+const uint materialStone = 1;
+const uint materialGrass = 2;
+
+// Same rules TerrainSettings describes, flatter than the max angle means a larger normal y
+vec3 materialColour(vec3 normal, float height) {
+	// Block faces name their material
+	if (fragMaterial != materialShaded) {
+		if (fragMaterial == materialStone) return material.stoneColour.rgb;
+		if (fragMaterial == materialGrass) return material.grassColour.rgb;
+		return material.snowColour.rgb;
+	}
+	if (height >= material.snowMinHeight && normal.y >= material.snowMinNormalY) return material.snowColour.rgb;
+	if (normal.y >= material.grassMinNormalY) return material.grassColour.rgb;
+	return material.stoneColour.rgb;
+}
+
+void main() {
+	vec3 normal = normalize(fragNormal);
+	float diffuse = max(dot(normal, -ubo.lightDirection), 0.0);
+
+	// Every light level down is 0.8 times as bright, the sun only reaches as far as the skylight
+	vec2 levels = pow(vec2(0.8), (1.0 - fragLight) * 15.0);
+	vec3 light = vec3((ambient + (1.0 - ambient) * diffuse) * levels.x) + blockLightColour * levels.y * step(0.5 / 15.0, fragLight.y);
+
+	// Baked occlusion darkens the direct light too, there are no shadows to keep it out of caves
+	light *= 1.0 - fragOcclusion;
+	outColour = vec4(materialColour(normal, fragHeight) * light, 1.0);
+}
@@ -0,0 +1,59 @@
+#version 450
+
+// TerrainModel::Vertex
+layout (location = 0) in vec4 position;	// unorm16 over the model's extent, w is not part of it
+layout (location = 1) in vec2 normal;	// octahedral snorm8
+layout (location = 2) in uint material;	// TerrainMaterial
+layout (location = 3) in float occlusion;	// unorm8, baked by LatticeOcclusion
+layout (location = 4) in uint light;	// LightVolume, sky << 4 | block
+layout (location = 5) in float morphHeight;	// horizon only, unorm16 over the extent, material holds the level
+
+layout (location = 0) out vec3 fragNormal;
+layout (location = 1) out float fragHeight;
+layout (location = 2) flat out uint fragMaterial;
+layout (location = 3) out float fragOcclusion;
+layout (location = 4) out vec2 fragLight;
+
+layout (set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projectionView;
+	vec3 lightDirection;
+} ubo;
+
+layout (push_constant) uniform Push {
+	mat4 meshMatrix;
+	vec4 positionScale;
+	vec4 morph;	// xy the camera's xz in the model, zw where level 0 starts and ends morphing, 0 unless the horizon
+} push;
+
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+	if (n.y < 0.0) {
+		vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+		n.xz = (1.0 - abs(n.zx)) * signs;
+	}
+	return normalize(n);
+}
+
+void main() {
+	vec3 local = position.xyz * push.positionScale.xyz;
+	fragMaterial = material;
+	fragOcclusion = occlusion;
+	fragLight = vec2(float(light >> 4), float(light & 15u)) / 15.0;
+
+	// HorizonClipmap, towards the next level's height as the camera nears the edge of this one
+	if (push.morph.w > 0.0) {
+		vec2 offset = abs(local.xz - push.morph.xy) / float(1u << material);
+		float weight = smoothstep(push.morph.z, push.morph.w, max(offset.x, offset.y));
+		local.y = mix(local.y, morphHeight * push.positionScale.y, weight);
+		fragMaterial = 0u;
+		fragOcclusion = 0.0;
+		fragLight = vec2(1.0, 0.0);
+	}
+
+	vec4 world = push.meshMatrix * vec4(local, 1.0);
+	gl_Position = ubo.projectionView * world;
+
+	// Terrain models are only ever translated
+	fragNormal = decodeOctahedral(normal);
+	fragHeight = world.y;
+}
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 #include <string>
 #include <stdexcept>
+#include <atomic>
 
 class GameWindow{
 public:
@@ -54,9 +55,10 @@ private:
 	}
 
 
-	int width;
-	int height;
-	bool framebufferResized = false;
+	// Set by the main thread's callbacks, read by the render thread
+	std::atomic<int> width;
+	std::atomic<int> height;
+	std::atomic<bool> framebufferResized{false};
 
 	std::string windowName;
 	GLFWwindow *window;
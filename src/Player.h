@@ -14,34 +14,25 @@ public:
         : camera(_camera), input(_input)
     {
         input.SetMouseMode(MouseMode::Play);
+        collider.position = camera.position - glm::vec3(0.0f, eyeHeight, 0.0f);
+        previousPosition = collider.position;
     }
 
 
 
-	void Update(float frameTime, float aspect){
+	// Once a frame before the simulation ticks, turning follows the mouse at the frame rate
+	void Update(float aspect){
 
 		// Update input system state
     	input.UpdateInputs();
 
-
-		float speed = 20.0f;
-
-
-		glm::vec2 moveInput = input.Movement() * speed * frameTime;
     	glm::vec2 mouseLook = input.MouseLook() * 0.00045f;
-    	glm::vec3 move = moveInput.x * camera.Right() + glm::vec3(0.0f, input.MovementY() * speed * frameTime, 0.0f) + moveInput.y * camera.Forward();
     	glm::vec3 rot{mouseLook.y, -mouseLook.x, 0.0f};
-
-
-    	camera.position += move;
     	camera.rotation += rot;
     	camera.rotation.x = glm::clamp(camera.rotation.x, -glm::pi<float>() * 0.5f, glm::pi<float>() * 0.5f); // clamp
-
-		// set camera view
-		camera.setView();
 		camera.setPerspectiveProjection(aspect);
 
-		//RayHit hit = Physics::RayCast(Vector3(camera.position), Vector3(camera.Forward()));
+		//RayHit hit = Physics::RayCast(camera.position, camera.Forward());
 
 		if (input.GetKeyDown(InputSystem::KeyCode::Escape))
 		{
@@ -50,12 +41,26 @@ public:
 		} 
 	}
 
+	// Once a simulation tick, moves the same distance however fast frames are drawn
+	void FixedUpdate(float tickTime){
+		float speed = 20.0f;
+
+		glm::vec2 moveInput = input.Movement() * speed * tickTime;
+    	glm::vec3 move = moveInput.x * camera.Right() + glm::vec3(0.0f, input.MovementY() * speed * tickTime, 0.0f) + moveInput.y * camera.Forward();
+
+    	// Flies freely but slides along the terrain instead of passing through it
+    	previousPosition = collider.position;
+    	Physics::MoveCapsule(collider, move);
+	}
+
+	// Once a frame after the ticks, places the camera alpha of the way from the last tick's start to its end
+	void Interpolate(float alpha){
+		camera.position = glm::mix(previousPosition, collider.position, alpha) + glm::vec3(0.0f, eyeHeight, 0.0f);
+
+		// set camera view
+		camera.setView();
+	}
 
-	struct CapsuleCollider{
-		Vector3 position;
-		float radius;
-		float height;
-	};
 
 	glm::vec3 getPlayerPosition(){
 		return camera.position;
@@ -63,11 +68,14 @@ public:
 
 	// Public member variables
 	Camera camera;	
+	CapsuleCollider collider;
 
 private:
+	static constexpr float eyeHeight = 0.6f;	// above the collider's centre
 
 	// Private member variables
     InputSystem input;
+    glm::vec3 previousPosition;	// collider before the last tick
 };
 }
 
@@ -11,6 +11,7 @@
 #include "engine_device.h"
 #include "engine_mesh.h"
 #include "engine_game_object.h"
+#include "engine_entities.h"
 #include "render_system.h"
 #include "terrain_render_system.h"
 #include "camera.h"
@@ -20,13 +21,19 @@
 #include "engine_descriptor.h"
 #include "player.h"
 #include "engine_physics.h"
+#include "engine_timestep.h"
+#include "engine_render_snapshot.h"
 
 #include <memory>
 #include <vector>
 #include <iostream>
 #include <stdexcept>
 #include <array>
+#include <algorithm>
 #include <chrono>
+#include <thread>
+#include <exception>
+#include <cmath>
 
 namespace Engine{
 
@@ -47,7 +54,7 @@ public:
 		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, EngineSwapChain::MAX_FRAMES_IN_FLIGHT)
 		.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, EngineSwapChain::MAX_FRAMES_IN_FLIGHT)
 		.build();
-		loadGameObjects();
+		loadEntities();
 	}
 
 	~App() {}
@@ -92,11 +99,15 @@ public:
 	    float aspect = renderer.getAspectRatio();
 	    auto currentTime = std::chrono::high_resolution_clock::now();
 	    float frameTime;
+	    FixedTimestep timestep{simulationRate};
+	    SnapshotTransforms();
 
 
 	    // ENGINE PHYSICS ///////////////////////////////////////////////////   
 		Physics physics{};
-		physics.SetGameObjectPtrs(CreateGameObjectPtrs());
+		entities.UpdateTransforms();
+		physics.SetEntities(&entities);
+		physics.SetTerrain(&terrain);
 
 	    // SCRIPTABLE ZONE //////////////////////////////////////////////////
 	    Camera camera{};
@@ -109,61 +120,115 @@ public:
 	    RenderSystem renderSystem{engineDevice, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()}; // Game Object Render System
 		TerrainRenderSystem terrainRenderSystem{engineDevice, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()}; // Terrain Render System
 
+		// RENDER THREAD ///////////////////////////////////////////////////
+		// Records and submits the newest snapshot while this thread simulates the next one
+		TripleBuffer<RenderSnapshot> snapshots;
+		std::exception_ptr renderError;
+		std::thread renderThread([&]() {
+			// Models each frame in flight draws, released once its fence has been waited on
+			std::array<std::vector<std::shared_ptr<const void>>, EngineSwapChain::MAX_FRAMES_IN_FLIGHT> retained;
+			// Serial of the snapshot each frame in flight draws, every older one is retired
+			std::array<uint64_t, EngineSwapChain::MAX_FRAMES_IN_FLIGHT> drawing{};
+			try {
+				while (snapshots.Acquire()) {
+					const RenderSnapshot& snapshot = snapshots.Front();
+					auto commandBuffer = renderer.beginFrame();
+					if (!commandBuffer) {
+						// The swap chain was rebuilt with the device idle
+						SnapshotSerials::Retire(snapshot.serial);
+						continue;
+					}
+
+					int frameIndex = renderer.getFrameIndex();
+					retained[frameIndex].clear();
+					snapshot.RetainModels(retained[frameIndex]);
+					drawing[frameIndex] = snapshot.serial;
+					uint64_t oldest = *std::min_element(drawing.begin(), drawing.end());
+					if (oldest > 0) SnapshotSerials::Retire(oldest - 1);
+
+					Camera frameCamera = snapshot.camera;
+					FrameInfo frameInfo{
+						frameIndex,
+						snapshot.frameTime,
+						commandBuffer,
+						frameCamera,
+						globalDescriptorSets[frameIndex]
+					};
+
+					// update
+					GlobalUbo ubo{};
+					ubo.projectionView = frameCamera.getProjection() * frameCamera.getView();
+					uboBuffers[frameIndex]->writeToBuffer(&ubo);
+					uboBuffers[frameIndex]->flush();
+
+					// render
+					renderer.beginSwapChainRenderPass(commandBuffer);
+					renderSystem.renderGameObjects(frameInfo, snapshot.objects);
+					terrainRenderSystem.renderTerrain(frameInfo, snapshot);
+					renderer.endSwapChainRenderPass(commandBuffer);
+					renderer.endFrame();
+				}
+			}
+			catch (...) {
+				renderError = std::current_exception();
+				snapshots.Close();
+			}
+			std::lock_guard<std::mutex> lock(engineDevice.queueMutex());
+			vkDeviceWaitIdle(engineDevice.device());
+		});
+
+		// Stops the render thread however the loop below ends
+		struct RenderThreadJoin {
+			TripleBuffer<RenderSnapshot>& snapshots;
+			std::thread& thread;
+			~RenderThreadJoin() {
+				snapshots.Close();
+				if (thread.joinable()) thread.join();
+			}
+		} renderThreadJoin{snapshots, renderThread};
+
 		// INTERNAL LOOP RUNS ONCE PER FRAME ///////////////////////////////
-	    while (!window.shouldClose()) {
+	    while (!window.shouldClose() && !snapshots.Closed()) {
 	        glfwPollEvents();
 
+	        // Keeps the window responsive while the render thread takes the last snapshot
+	        if (!snapshots.WaitTaken(std::chrono::milliseconds(10))) continue;
+
 	        // calculates time elapsed since last frame
 	        auto newTime = std::chrono::high_resolution_clock::now();
 	        frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 	        currentTime = newTime;
 
 	        // execute scripts before rendering to screen
-	        player.Update(frameTime, renderer.getAspectRatio());
+	        player.Update(WindowAspect());
+
+	        // Simulation runs in fixed ticks, frames draw between the last two
+	        int ticks = timestep.Advance(frameTime);
+	        for (int i = 0; i < ticks; ++i) {
+	        	SnapshotTransforms();
+	        	player.FixedUpdate(timestep.TickTime());
+	        	UpdateEntities(timestep.TickTime());
+	        }
+	        float alpha = timestep.Alpha();
+	        player.Interpolate(alpha);
+
+	        // World matrices of whatever the ticks moved, the rest keep theirs
+	        entities.UpdateTransforms();
 
 	        // Update terrain
 	       	glm::vec3 playerPos = player.getPlayerPosition();
 			UpdateTerrain(playerPos.x, playerPos.z);
+			physics.UpdateScene();
 
-
-
-	        if (auto commandBuffer = renderer.beginFrame()) {
-	        	int frameIndex = renderer.getFrameIndex();
-	        	FrameInfo frameInfo{
-	        		frameIndex,
-	        		frameTime,
-	        		commandBuffer,
-	        		camera,
-	        		globalDescriptorSets[frameIndex]
-	        	};
-
-	        	// update
-	        	GlobalUbo ubo{};
-	        	ubo.projectionView = player.camera.getProjection() * player.camera.getView();
-	        	uboBuffers[frameIndex]->writeToBuffer(&ubo);
-	        	uboBuffers[frameIndex]->flush();
-
-	        	// render
-	            renderer.beginSwapChainRenderPass(commandBuffer);
-	            renderSystem.renderGameObjects(frameInfo, gameObjects);
-				terrainRenderSystem.renderTerrain(frameInfo, terrain);
-	            renderer.endSwapChainRenderPass(commandBuffer);
-	            renderer.endFrame();
-	        }
+			// Hand the frame to the render thread
+			BuildSnapshot(snapshots.Back(), player.camera, frameTime, alpha);
+			snapshots.Publish();
 	    }
-	    vkDeviceWaitIdle(engineDevice.device());
+	    snapshots.Close();
+	    if (renderThread.joinable()) renderThread.join();
+	    if (renderError) std::rethrow_exception(renderError);
 	}
 
-	// Return a vector of pointers belonging to App
-	std::vector<EngineGameObject*> CreateGameObjectPtrs(){
-		std::vector<EngineGameObject*> gameObjectPtrs;
-	    gameObjectPtrs.reserve(gameObjects.size());  // Reserve memory to avoid reallocations
-
-	    for (auto& gameObject : gameObjects) {
-	        gameObjectPtrs.push_back(&gameObject);
-	    }
-	    return gameObjectPtrs;
-	}
 
 
 
@@ -173,17 +238,122 @@ public:
 private:
 
 
-	void loadGameObjects(){
-		
+	// A ring of cubes over the spawn, children of a hub that turns each tick
+	void loadEntities(){
+		std::shared_ptr<EngineModel> cube = CreateCubeModel(engineDevice);
+		TransformComponent hub;
+		hub.translation = {0.0f, 15.0f, 0.0f};
+		ringHub = entities.Create(hub);
+
+		constexpr int cubes = 8;
+		for (int i = 0; i < cubes; ++i){
+			float angle = glm::two_pi<float>() * i / cubes;
+			TransformComponent transform;
+			transform.translation = glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * 6.0f;
+			transform.rotation.y = -angle;
+			transform.scale = glm::vec3(0.5f);
+			Entity entity = entities.Create(transform);
+			entities.SetParent(entity, ringHub);
+			entities.SetRender(entity, cube);
+		}
+	}
+
+	// Moves the entities by one tick
+	void UpdateEntities(float tickTime) {
+		TransformComponent hub = entities.GetTransform(ringHub);
+		hub.rotation.y = std::fmod(hub.rotation.y + ringTurnRate * tickTime, glm::two_pi<float>());
+		entities.SetTransform(ringHub, hub);
+	}
+
+	// Unit cube about the origin, a colour per face
+	static std::shared_ptr<EngineModel> CreateCubeModel(EngineDevice& device) {
+		static const glm::vec3 colours[3] = {{0.9f, 0.3f, 0.2f}, {0.3f, 0.8f, 0.3f}, {0.2f, 0.4f, 0.9f}};
+		std::vector<EngineModel::Vertex> vertices;
+		for (int axis = 0; axis < 3; ++axis){
+			for (float side : {-0.5f, 0.5f}){
+				// Two triangles in the face, clockwise seen from outside like the pipeline's front faces
+				glm::vec3 u{0.0f}, v{0.0f}, centre{0.0f};
+				u[(axis + 1) % 3] = 0.5f;
+				v[(axis + 2) % 3] = side > 0.0f ? 0.5f : -0.5f;
+				centre[axis] = side;
+				glm::vec3 corners[4] = {centre - u - v, centre + u - v, centre + u + v, centre - u + v};
+				for (int i : {0, 2, 1, 0, 3, 2}) vertices.push_back({corners[i], colours[axis] * (side > 0.0f ? 1.0f : 0.6f)});
+			}
+		}
+		return std::make_shared<EngineModel>(device, vertices);
 	}
 
 	void loadTerrain() {
 		Terrain::TerrainSettings terrainSettings;
 		terrain = Terrain(terrainSettings);
+		terrain.EnableRegionCache("saves/regions");
 	}
 
 	void UpdateTerrain(float playerX, float playerZ) {
-		terrain.UpdateChunks(20, playerX, playerZ, engineDevice);
+		terrain.UpdateChunks(terrainRenderDistance, playerX, playerZ, engineDevice);
+		terrain.UpdateHorizon(terrainRenderDistance, playerX, playerZ, engineDevice);
+	}
+
+	// Aspect of the window's framebuffer, 1 while it is minimised
+	float WindowAspect() {
+		VkExtent2D extent = window.getExtent();
+		if (extent.width == 0 || extent.height == 0) return 1.0f;
+		return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+	}
+
+	// Copies what the render thread draws next, leaving out chunks and objects outside the view
+	void BuildSnapshot(RenderSnapshot& snapshot, const Camera& camera, float frameTime, float alpha) {
+		snapshot.serial = SnapshotSerials::Next();
+		snapshot.camera = camera;
+		snapshot.frameTime = frameTime;
+		snapshot.terrainSettings = terrain.GetSettings();
+		Frustum frustum{camera.getProjection() * camera.getView()};
+
+		// Walks the packed render components, cached matrices unless the entity moved in the last tick,
+		// then tests all their bounds against the frustum together
+		snapshot.models = entities.Models();
+		snapshot.objects.clear();
+		cullBounds.clear();
+		for (const RenderComponent& render : entities.Renderables()) {
+			RenderSnapshot::Object object{snapshot.models[render.model].get()};
+			entities.RenderMatrices(render.transform, alpha, object.meshMatrix, object.normalMatrix);
+			cullBounds.push_back(object.model->getBvh().Bounds().Transformed(object.meshMatrix));
+			snapshot.objects.push_back(object);
+		}
+		CullBounds(frustum);
+		size_t kept = 0;
+		for (size_t i = 0; i < snapshot.objects.size(); ++i) {
+			if (cullVisible[i]) snapshot.objects[kept++] = snapshot.objects[i];
+		}
+		snapshot.objects.resize(kept);
+
+		snapshot.chunks.clear();
+		snapshot.chunkBuffers.clear();
+		cullBounds.clear();
+		for (auto& chunkObject : terrain.chunkObjects) {
+			if (chunkObject.model) cullBounds.push_back(chunkObject.model->getBvh().Bounds().Transformed(chunkObject.getMatrix()));
+		}
+		CullBounds(frustum);
+		size_t next = 0;
+		for (auto& chunkObject : terrain.chunkObjects) {
+			if (!chunkObject.model || !cullVisible[next++]) continue;
+			snapshot.chunks.push_back(chunkObject);
+			snapshot.chunkBuffers.push_back(chunkObject.model->drawBuffer(snapshot.serial));
+		}
+		snapshot.horizon = terrain.horizonObject;
+		snapshot.horizonBuffer = snapshot.horizon.model ? snapshot.horizon.model->drawBuffer(snapshot.serial) : VkBuffer{};
+		snapshot.horizonRingCells = terrain.GetHorizon().getRingCells();
+	}
+
+	// Which of cullBounds the frustum meets, into cullVisible
+	void CullBounds(const Frustum& frustum) {
+		cullVisible.resize(cullBounds.size());
+		frustum.Intersects(cullBounds.data(), cullBounds.size(), cullVisible.data());
+	}
+
+	// Start of a tick, the renderer blends from these transforms to the ones the tick leaves
+	void SnapshotTransforms() {
+		entities.SnapshotTransforms();
 	}
 
 
@@ -192,10 +362,18 @@ private:
     Renderer renderer{window, engineDevice};
 
     std::unique_ptr<EngineDescriptorPool> globalPool{};
-    std::vector<EngineGameObject> gameObjects;
+    EntityStore entities;
+    Entity ringHub;
+    static constexpr float ringTurnRate = 0.5f;	// radians a second
+    std::vector<Aabb> cullBounds;	// BuildSnapshot's scratch
+    std::vector<uint8_t> cullVisible;
 
     // TERRAIN
 	Terrain terrain;
+	int terrainRenderDistance = 20;
+
+	// SIMULATION
+	static constexpr float simulationRate = 60.0f;	// ticks a second
 };
 } // namespace
 #endif
@@ -0,0 +1,186 @@
+#ifndef ENGINE_BROADPHASE_H
+#define ENGINE_BROADPHASE_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "engine_bvh.h"
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace Engine{
+
+// Broadphase over boxes hashed into a uniform grid of cells. An entry is listed in every cell its
+// box overlaps, so queries only look at the cells they touch and their cost follows how crowded
+// those cells are rather than how many entries there are. Moving an entry within the cells it
+// already covers only updates its box. Queries return candidates whose boxes meet the query.
+class SpatialHashGrid{
+public:
+
+	explicit SpatialHashGrid(float _cellSize = 4.0f) : cellSize{_cellSize} {}
+
+	float CellSize() const {return cellSize;}
+	size_t size() const {return entries.size();}
+
+	void Clear() {
+		cells.clear();
+		entries.clear();
+		occupied = Aabb{};
+	}
+
+	// Adds or moves entry id, ids index a dense array so keep them small
+	void Set(uint32_t id, const Aabb& bounds) {
+		if (id >= entries.size()) entries.resize(id + 1);
+		Entry& entry = entries[id];
+		glm::ivec3 low = Cell(bounds.min), high = Cell(bounds.max);
+		if (entry.live && low == entry.low && high == entry.high){
+			entry.bounds = bounds;
+			return;
+		}
+		if (entry.live) Unlink(id);
+		entry = {bounds, low, high, true};
+		occupied.Grow(bounds);
+		ForCells(low, high, [&](uint64_t key){cells[key].push_back(id);});
+	}
+
+	void Remove(uint32_t id) {
+		if (id >= entries.size() || !entries[id].live) return;
+		Unlink(id);
+		entries[id].live = false;
+	}
+
+	// Entries whose boxes overlap box
+	void QueryBox(const Aabb& box, std::vector<uint32_t>& result) const {
+		result.clear();
+		ForCells(Cell(box.min), Cell(box.max), [&](uint64_t key){
+			auto cell = cells.find(key);
+			if (cell == cells.end()) return;
+			for (uint32_t id : cell->second){
+				if (Overlap(entries[id].bounds, box)) result.push_back(id);
+			}
+		});
+		Unique(result);
+	}
+
+	// Entries whose boxes come within radius of centre
+	void QuerySphere(const glm::vec3& centre, float radius, std::vector<uint32_t>& result) const {
+		Aabb box{centre - radius, centre + radius};
+		QueryBox(box, result);
+		result.erase(std::remove_if(result.begin(), result.end(), [&](uint32_t id){
+			const Aabb& bounds = entries[id].bounds;
+			glm::vec3 nearest = glm::clamp(centre, bounds.min, bounds.max);
+			return glm::dot(nearest - centre, nearest - centre) > radius * radius;
+		}), result.end());
+	}
+
+	// Entries whose boxes the ray enters before maxDistance, in units of direction. The ray walks the
+	// cells it crosses (Amanatides and Woo) and stops where the occupied cells end.
+	void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& result) const {
+		result.clear();
+		if (cells.empty() || direction == glm::vec3(0.0f)) return;
+		glm::vec3 inverseDirection = 1.0f / direction;
+
+		// Clipped to the box every entry has been in
+		float t;
+		if (!occupied.Hit(origin, inverseDirection, maxDistance, t)) return;
+		glm::vec3 t0 = (occupied.min - origin) * inverseDirection, t1 = (occupied.max - origin) * inverseDirection;
+		float exit = std::min(std::min(std::max(t0.x, t1.x), std::max(t0.y, t1.y)), std::min(std::max(t0.z, t1.z), maxDistance));
+
+		glm::vec3 start = origin + direction * t;
+		glm::ivec3 cell = Cell(start);
+		glm::ivec3 step{0};
+		glm::vec3 tMax{std::numeric_limits<float>::infinity()}, tDelta{std::numeric_limits<float>::infinity()};
+		for (int axis = 0; axis < 3; ++axis){
+			if (direction[axis] == 0.0f) continue;
+			step[axis] = direction[axis] > 0.0f ? 1 : -1;
+			float boundary = (cell[axis] + (direction[axis] > 0.0f ? 1 : 0)) * cellSize;
+			tMax[axis] = t + (boundary - start[axis]) * inverseDirection[axis];
+			tDelta[axis] = cellSize * std::abs(inverseDirection[axis]);
+		}
+		while (true){
+			auto found = cells.find(Key(cell));
+			if (found != cells.end()){
+				for (uint32_t id : found->second){
+					float hit;
+					if (entries[id].bounds.Hit(origin, inverseDirection, maxDistance, hit)) result.push_back(id);
+				}
+			}
+			int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+			if (tMax[axis] > exit) break;
+			cell[axis] += step[axis];
+			tMax[axis] += tDelta[axis];
+		}
+		Unique(result);
+	}
+
+	// Every pair of entries whose boxes overlap, once each with the lower id first. A pair is
+	// reported by the cell holding the low corner of the boxes' overlap.
+	void OverlappingPairs(std::vector<std::pair<uint32_t, uint32_t>>& result) const {
+		result.clear();
+		for (const auto& [key, ids] : cells){
+			for (size_t i = 0; i < ids.size(); ++i){
+				for (size_t j = i + 1; j < ids.size(); ++j){
+					const Aabb& a = entries[ids[i]].bounds;
+					const Aabb& b = entries[ids[j]].bounds;
+					if (!Overlap(a, b) || Key(Cell(glm::max(a.min, b.min))) != key) continue;
+					result.push_back(std::minmax(ids[i], ids[j]));
+				}
+			}
+		}
+	}
+
+private:
+	struct Entry{
+		Aabb bounds;
+		glm::ivec3 low{0}, high{0};	// cells covered
+		bool live = false;
+	};
+
+	float cellSize;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+	std::vector<Entry> entries;
+	Aabb occupied;	// grows with the entries, Clear empties it
+
+	glm::ivec3 Cell(const glm::vec3& position) const {return glm::ivec3(glm::floor(position / cellSize));}
+
+	// 21 bits a coordinate, the grid wraps past a million cells
+	static uint64_t Key(const glm::ivec3& cell) {
+		const uint64_t mask = (1u << 21) - 1;
+		return (static_cast<uint64_t>(cell.x) & mask) | (static_cast<uint64_t>(cell.y) & mask) << 21 | (static_cast<uint64_t>(cell.z) & mask) << 42;
+	}
+
+	template <typename Visit>
+	static void ForCells(const glm::ivec3& low, const glm::ivec3& high, Visit visit) {
+		for (int x = low.x; x <= high.x; ++x)
+			for (int y = low.y; y <= high.y; ++y)
+				for (int z = low.z; z <= high.z; ++z)
+					visit(Key({x, y, z}));
+	}
+
+	void Unlink(uint32_t id) {
+		const Entry& entry = entries[id];
+		ForCells(entry.low, entry.high, [&](uint64_t key){
+			auto cell = cells.find(key);
+			std::vector<uint32_t>& ids = cell->second;
+			ids.erase(std::find(ids.begin(), ids.end(), id));
+			if (ids.empty()) cells.erase(cell);
+		});
+	}
+
+	static bool Overlap(const Aabb& a, const Aabb& b) {
+		return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+	}
+
+	static void Unique(std::vector<uint32_t>& ids) {
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,402 @@
+#ifndef ENGINE_BVH_H
+#define ENGINE_BVH_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "engine_simd.h"
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+struct Aabb{
+	glm::vec3 min{std::numeric_limits<float>::infinity()};
+	glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+	void Grow(const glm::vec3& point) {min = glm::min(min, point); max = glm::max(max, point);}
+	void Grow(const Aabb& box) {min = glm::min(min, box.min); max = glm::max(max, box.max);}
+	void Grow(const glm::vec3* points, size_t count) {GrowBounds(points, count, min, max);}
+	bool empty() const {return min.x > max.x;}
+	glm::vec3 Centre() const {return (min + max) * 0.5f;}
+
+	float SurfaceArea() const {
+		if (empty()) return 0.0f;
+		glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	// Slab test, the entry distance along the ray when it enters before maxDistance
+	bool Hit(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, float& entry) const {
+		glm::vec3 t0 = (min - origin) * inverseDirection;
+		glm::vec3 t1 = (max - origin) * inverseDirection;
+		glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+		entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+		float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+		return entry <= exit;
+	}
+
+	// Bounds of the box after an affine transform
+	Aabb Transformed(const glm::mat4& matrix) const {
+		Aabb box;
+		if (empty()) return box;
+		glm::vec3 corners[8];
+		for (int i = 0; i < 8; ++i) corners[i] = {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z};
+		TransformPoints(matrix, corners, 8, corners);
+		box.Grow(corners, 8);
+		return box;
+	}
+};
+
+// Four rays traced together. Lanes whose closest distance is negative take no part.
+struct RayPacket{
+	Vector4x3 origin, direction, inverseDirection;
+	int signs[3];	// of the lanes' summed direction, which child a packet visits first
+
+	RayPacket(const Vector4x3& _origin, const Vector4x3& _direction) : origin{_origin}, direction{_direction} {
+		Float4 one(1.0f);
+		inverseDirection = {one / direction.x, one / direction.y, one / direction.z};
+		for (int axis = 0; axis < 3; ++axis){
+			const Float4& d = direction[axis];
+			signs[axis] = d.Lane(0) + d.Lane(1) + d.Lane(2) + d.Lane(3) < 0.0f ? -1 : 1;
+		}
+	}
+
+	// The same rays through an affine transform, distances along them are unchanged
+	RayPacket Transformed(const glm::mat4& matrix) const {
+		Vector4x3 o, d;
+		for (int row = 0; row < 3; ++row){
+			Float4 m0(matrix[0][row]), m1(matrix[1][row]), m2(matrix[2][row]);
+			o[row] = m0 * origin.x + m1 * origin.y + m2 * origin.z + Float4(matrix[3][row]);
+			d[row] = m0 * direction.x + m1 * direction.y + m2 * direction.z;
+		}
+		return RayPacket(o, d);
+	}
+
+	// Lanes that enter the box before their distance
+	Float4 Hits(const Aabb& box, const Float4& distance) const {
+		Float4 entry(0.0f), exit = distance;
+		for (int axis = 0; axis < 3; ++axis){
+			Float4 t0 = (Float4(box.min[axis]) - origin[axis]) * inverseDirection[axis];
+			Float4 t1 = (Float4(box.max[axis]) - origin[axis]) * inverseDirection[axis];
+			entry = Float4::Max(entry, Float4::Min(t0, t1));
+			exit = Float4::Min(exit, Float4::Max(t0, t1));
+		}
+		return entry <= exit;
+	}
+};
+
+// Bounding volume hierarchy over a list of boxes, split by the surface area heuristic over binned
+// centroids. Children are stored side by side after their parent, so walking the nodes backwards
+// visits every child before its parent, which is all Refit needs.
+class Bvh{
+public:
+
+	struct Node{
+		Aabb bounds;
+		uint32_t first;	// first primitive of a leaf, left child otherwise
+		uint32_t count;	// primitives in a leaf, 0 for an inner node
+	};
+
+	static constexpr uint32_t maxLeafSize = 4;
+
+	void Build(const std::vector<Aabb>& boxes) {
+		nodes.clear();
+		primitives.resize(boxes.size());
+		for (uint32_t i = 0; i < primitives.size(); ++i) primitives[i] = i;
+		if (boxes.empty()) return;
+		nodes.reserve(2 * boxes.size());
+		nodes.push_back({{}, 0, static_cast<uint32_t>(boxes.size())});
+		Subdivide(0, boxes, 0);
+	}
+
+	// Recomputes the bounds after boxes moved, the tree keeps its shape
+	void Refit(const std::vector<Aabb>& boxes) {
+		for (size_t n = nodes.size(); n-- > 0;){
+			Node& node = nodes[n];
+			node.bounds = Aabb{};
+			if (node.count == 0){
+				node.bounds.Grow(nodes[node.first].bounds);
+				node.bounds.Grow(nodes[node.first + 1].bounds);
+			}
+			else for (uint32_t i = node.first; i < node.first + node.count; ++i) node.bounds.Grow(boxes[primitives[i]]);
+		}
+	}
+
+	// Closest hit along the ray. hit(primitive, maxDistance) returns the primitive's hit distance,
+	// infinity for a miss. Returns the primitive hit, or -1.
+	template<typename HitFunction>
+	int64_t Closest(const glm::vec3& origin, const glm::vec3& direction, float& distance, HitFunction hit) const {
+		int64_t closest = -1;
+		if (nodes.empty()) return closest;
+		glm::vec3 inverseDirection = 1.0f / direction;
+		float entry;
+		if (!nodes[0].bounds.Hit(origin, inverseDirection, distance, entry)) return closest;
+
+		uint32_t stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0){
+			const Node& node = nodes[stack[--top]];
+			if (node.count > 0){
+				for (uint32_t i = node.first; i < node.first + node.count; ++i){
+					float t = hit(primitives[i], distance);
+					if (t < distance){
+						distance = t;
+						closest = primitives[i];
+					}
+				}
+				continue;
+			}
+
+			// Nearer child on top of the stack, a farther one is skipped once a hit is closer
+			float nearEntry, farEntry;
+			uint32_t nearChild = node.first, farChild = node.first + 1;
+			bool nearHit = nodes[nearChild].bounds.Hit(origin, inverseDirection, distance, nearEntry);
+			bool farHit = nodes[farChild].bounds.Hit(origin, inverseDirection, distance, farEntry);
+			if (nearHit && farHit && farEntry < nearEntry){
+				std::swap(nearChild, farChild);
+				std::swap(nearEntry, farEntry);
+			}
+			if (farHit) stack[top++] = farChild;
+			if (nearHit) stack[top++] = nearChild;
+		}
+		return closest;
+	}
+
+	// Closest hits of a packet, a node is opened when any lane reaches it. hit(primitive, distance)
+	// lowers the distances of the lanes that hit the primitive closer.
+	template<typename HitFunction>
+	void ClosestPacket(const RayPacket& rays, Float4& distance, HitFunction hit) const {
+		if (nodes.empty()) return;
+		uint32_t stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0){
+			const Node& node = nodes[stack[--top]];
+			if (rays.Hits(node.bounds, distance).Bits() == 0) continue;
+			if (node.count > 0){
+				for (uint32_t i = node.first; i < node.first + node.count; ++i) hit(primitives[i], distance);
+				continue;
+			}
+
+			// The child first along the packet's direction on the axis separating them most
+			const Aabb& left = nodes[node.first].bounds;
+			const Aabb& right = nodes[node.first + 1].bounds;
+			glm::vec3 separation = right.Centre() - left.Centre();
+			int axis = std::abs(separation.x) > std::abs(separation.y) ? (std::abs(separation.x) > std::abs(separation.z) ? 0 : 2) : (std::abs(separation.y) > std::abs(separation.z) ? 1 : 2);
+			bool leftFirst = (separation[axis] >= 0.0f) == (rays.signs[axis] > 0);
+			stack[top++] = leftFirst ? node.first + 1 : node.first;
+			stack[top++] = leftFirst ? node.first : node.first + 1;
+		}
+	}
+
+	bool empty() const {return nodes.empty();}
+	const Aabb& Bounds() const {return nodes[0].bounds;}
+	size_t NodeCount() const {return nodes.size();}
+
+private:
+	static constexpr int binCount = 12;
+	static constexpr int maxDepth = 60;	// the traversal stack holds a path plus its siblings
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> primitives;
+
+	void Subdivide(uint32_t index, const std::vector<Aabb>& boxes, int depth) {
+		Node& node = nodes[index];
+		Aabb centres;
+		for (uint32_t i = node.first; i < node.first + node.count; ++i){
+			node.bounds.Grow(boxes[primitives[i]]);
+			centres.Grow(boxes[primitives[i]].Centre());
+		}
+		if (node.count <= maxLeafSize || depth == maxDepth) return;
+
+		// Cheapest split over the bins of every axis
+		int bestAxis = -1, bestSplit = 0;
+		float bestCost = node.bounds.SurfaceArea() * node.count;
+		for (int axis = 0; axis < 3; ++axis){
+			float low = centres.min[axis], extent = centres.max[axis] - low;
+			if (extent <= 0.0f) continue;
+			Aabb bins[binCount];
+			uint32_t counts[binCount] = {};
+			float scale = binCount / extent;
+			for (uint32_t i = node.first; i < node.first + node.count; ++i){
+				const Aabb& box = boxes[primitives[i]];
+				int bin = std::min(static_cast<int>((box.Centre()[axis] - low) * scale), binCount - 1);
+				bins[bin].Grow(box);
+				counts[bin]++;
+			}
+
+			// Areas and counts left of every split plane, then swept from the right
+			float leftArea[binCount - 1];
+			uint32_t leftCount[binCount - 1];
+			Aabb left;
+			uint32_t sum = 0;
+			for (int b = 0; b < binCount - 1; ++b){
+				left.Grow(bins[b]);
+				sum += counts[b];
+				leftArea[b] = left.SurfaceArea();
+				leftCount[b] = sum;
+			}
+			Aabb right;
+			sum = 0;
+			for (int b = binCount - 1; b > 0; --b){
+				right.Grow(bins[b]);
+				sum += counts[b];
+				float cost = leftArea[b - 1] * leftCount[b - 1] + right.SurfaceArea() * sum;
+				if (leftCount[b - 1] > 0 && sum > 0 && cost < bestCost){
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b;
+				}
+			}
+		}
+		if (bestAxis < 0) return;
+
+		float low = centres.min[bestAxis];
+		float scale = binCount / (centres.max[bestAxis] - low);
+		uint32_t* begin = primitives.data() + node.first;
+		uint32_t* middle = std::partition(begin, begin + node.count, [&](uint32_t p){
+			return std::min(static_cast<int>((boxes[p].Centre()[bestAxis] - low) * scale), binCount - 1) < bestSplit;
+		});
+		uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+
+		uint32_t first = node.first, count = node.count;
+		uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+		nodes.push_back({{}, first, leftCount});
+		nodes.push_back({{}, first + leftCount, count - leftCount});
+		nodes[index].first = leftChild;
+		nodes[index].count = 0;
+		Subdivide(leftChild, boxes, depth + 1);
+		Subdivide(leftChild + 1, boxes, depth + 1);
+	}
+};
+
+// Ray queries against a triangle mesh, built once from its positions and refitted when they change.
+// Indices pick the triangles' corners, without them every three positions make a triangle.
+class TriangleBvh{
+public:
+
+	struct Hit{
+		float distance = std::numeric_limits<float>::infinity();
+		glm::vec3 normal{0.0f};
+		int64_t triangle = -1;
+
+		bool hit() const {return triangle >= 0;}
+	};
+
+	TriangleBvh() = default;
+
+	TriangleBvh(const std::vector<glm::vec3>& _positions, const std::vector<uint32_t>& _indices = {}) : positions{_positions}, indices{_indices} {
+		std::vector<Aabb> boxes(TriangleCount());
+		for (size_t t = 0; t < boxes.size(); ++t) boxes[t] = TriangleBounds(t);
+		bvh.Build(boxes);
+	}
+
+	// Moves the positions from first on and refits, nothing happens when none of them changed
+	void Update(size_t first, const std::vector<glm::vec3>& moved) {
+		if (!std::equal(moved.begin(), moved.end(), positions.begin() + first)) {
+			std::copy(moved.begin(), moved.end(), positions.begin() + first);
+			std::vector<Aabb> boxes(TriangleCount());
+			for (size_t t = 0; t < boxes.size(); ++t) boxes[t] = TriangleBounds(t);
+			bvh.Refit(boxes);
+		}
+	}
+
+	// Closest triangle along the ray in front of maxDistance, distances are in units of direction
+	Hit Intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = std::numeric_limits<float>::infinity()) const {
+		Hit result;
+		result.distance = maxDistance;
+		result.triangle = bvh.Closest(origin, direction, result.distance, [&](uint32_t t, float closest){
+			return IntersectTriangle(t, origin, direction, closest);
+		});
+		if (result.hit()) result.normal = Normal(result.triangle);
+		else result.distance = std::numeric_limits<float>::infinity();
+		return result;
+	}
+
+	// Closest triangles of a packet, lanes hit closer than distance get it lowered and their triangle set
+	void IntersectPacket(const RayPacket& rays, Float4& distance, int64_t triangles[4]) const {
+		bvh.ClosestPacket(rays, distance, [&](uint32_t t, Float4& closest){
+			int lanes = IntersectTriangle(t, rays, closest);
+			for (int lane = 0; lane < 4; ++lane){
+				if (lanes & (1 << lane)) triangles[lane] = t;
+			}
+		});
+	}
+
+	glm::vec3 Normal(int64_t triangle) const {
+		glm::vec3 a = Corner(triangle, 0);
+		return glm::normalize(glm::cross(Corner(triangle, 1) - a, Corner(triangle, 2) - a));
+	}
+
+	bool empty() const {return bvh.empty();}
+	const Aabb& Bounds() const {return bvh.Bounds();}
+	size_t TriangleCount() const {return (indices.empty() ? positions.size() : indices.size()) / 3;}
+
+private:
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	Bvh bvh;
+
+	const glm::vec3& Corner(size_t triangle, int corner) const {
+		size_t i = triangle * 3 + corner;
+		return positions[indices.empty() ? i : indices[i]];
+	}
+
+	Aabb TriangleBounds(size_t triangle) const {
+		Aabb box;
+		for (int c = 0; c < 3; ++c) box.Grow(Corner(triangle, c));
+		return box;
+	}
+
+	// Möller–Trumbore, infinity unless the hit lies in [0, closest)
+	float IntersectTriangle(size_t triangle, const glm::vec3& origin, const glm::vec3& direction, float closest) const {
+		const float miss = std::numeric_limits<float>::infinity();
+		glm::vec3 a = Corner(triangle, 0);
+		glm::vec3 edge1 = Corner(triangle, 1) - a;
+		glm::vec3 edge2 = Corner(triangle, 2) - a;
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (determinant == 0.0f) return miss;
+		float invDeterminant = 1.0f / determinant;
+
+		glm::vec3 offset = origin - a;
+		float u = glm::dot(offset, p) * invDeterminant;
+		if (u < 0.0f || u > 1.0f) return miss;
+		glm::vec3 q = glm::cross(offset, edge1);
+		float v = glm::dot(direction, q) * invDeterminant;
+		if (v < 0.0f || u + v > 1.0f) return miss;
+
+		float distance = glm::dot(edge2, q) * invDeterminant;
+		return distance >= 0.0f && distance < closest ? distance : miss;
+	}
+
+	// The same test on four rays, lowers closest where they hit and returns those lanes as bits.
+	// A ray in the triangle's plane divides by 0 and fails every comparison.
+	int IntersectTriangle(size_t triangle, const RayPacket& rays, Float4& closest) const {
+		glm::vec3 a = Corner(triangle, 0);
+		glm::vec3 e1 = Corner(triangle, 1) - a;
+		glm::vec3 e2 = Corner(triangle, 2) - a;
+		Vector4x3 edge1{Float4(e1.x), Float4(e1.y), Float4(e1.z)};
+		Vector4x3 edge2{Float4(e2.x), Float4(e2.y), Float4(e2.z)};
+		Vector4x3 p = Vector4x3::Cross(rays.direction, edge2);
+		Float4 invDeterminant = Float4(1.0f) / Vector4x3::Dot(edge1, p);
+
+		Vector4x3 offset = rays.origin - Vector4x3{Float4(a.x), Float4(a.y), Float4(a.z)};
+		Float4 u = Vector4x3::Dot(offset, p) * invDeterminant;
+		Vector4x3 q = Vector4x3::Cross(offset, edge1);
+		Float4 v = Vector4x3::Dot(rays.direction, q) * invDeterminant;
+		Float4 distance = Vector4x3::Dot(edge2, q) * invDeterminant;
+
+		Float4 zero(0.0f);
+		Float4 hit = (u >= zero) & (v >= zero) & (u + v <= Float4(1.0f)) & (distance >= zero) & (distance < closest);
+		closest = Float4::Select(hit, distance, closest);
+		return hit.Bits();
+	}
+};
+
+} // namespace
+#endif
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <set>
 #include <unordered_set>
+#include <mutex>
 
 #include "GameWindow.h"
 
@@ -70,6 +71,7 @@ public:
 
 	~EngineDevice() {
 		vkDestroyCommandPool(device_, commandPool, nullptr);
+		vkDestroyCommandPool(device_, uploadCommandPool, nullptr);
 		vkDestroyDevice(device_, nullptr);
 
 		if (enableValidationLayers) {
@@ -92,6 +94,9 @@ public:
 	VkQueue graphicsQueue() { return graphicsQueue_; }
 	VkQueue presentQueue() { return presentQueue_; }
 
+	// Held around every submit, present and wait idle, the queues are used from more than one thread
+	std::mutex &queueMutex() { return queueMutex_; }
+
 	SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties){
@@ -160,11 +165,13 @@ public:
 			vkBindBufferMemory(device_, buffer, bufferMemory, 0);
 	}
 
+	// Single time commands come from their own pool so uploads don't touch the render thread's, only
+	// one thread may record them at a time
 	VkCommandBuffer beginSingleTimeCommands() {
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
+		allocInfo.commandPool = uploadCommandPool;
 		allocInfo.commandBufferCount = 1;
 
 		VkCommandBuffer commandBuffer;
@@ -186,10 +193,13 @@ public:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue_);
+		{
+			std::lock_guard<std::mutex> lock(queueMutex_);
+			vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
+			vkQueueWaitIdle(graphicsQueue_);
+		}
 
-		vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+		vkFreeCommandBuffers(device_, uploadCommandPool, 1, &commandBuffer);
 	}
 
 	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size){
@@ -404,7 +414,8 @@ private:
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
 		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-		if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS ||
+			vkCreateCommandPool(device_, &poolInfo, nullptr, &uploadCommandPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create command pool!");
 		}
 	}
@@ -575,6 +586,8 @@ private:
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	GameWindow &window;
 	VkCommandPool commandPool;
+	VkCommandPool uploadCommandPool;
+	std::mutex queueMutex_;
 
 	VkDevice device_;
 	VkSurfaceKHR surface_;
@@ -0,0 +1,459 @@
+#ifndef ENGINE_ENTITIES_H
+#define ENGINE_ENTITIES_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "engine_game_object.h"
+#include "engine_model.h"
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+namespace Engine{
+
+// Names an entity for as long as it lives. Indices are reused after Destroy with the generation
+// moved on, so an old handle never reaches the entity that took its place.
+struct Entity{
+	static constexpr uint32_t invalidIndex = ~0u;
+
+	uint32_t index = invalidIndex;
+	uint32_t generation = 0;
+
+	bool valid() const {return index != invalidIndex;}
+	bool operator==(const Entity& other) const {return index == other.index && generation == other.generation;}
+	bool operator!=(const Entity& other) const {return !(*this == other);}
+};
+
+// A model an entity draws, model indexes EntityStore::Models
+struct RenderComponent{
+	uint32_t transform;	// dense index into EntityStore::Transforms
+	uint32_t model;
+	glm::vec3 colour{};
+};
+
+// Transforms of every live entity, one dense array per field, kept packed as entities come and go
+struct TransformArrays{
+	std::vector<glm::vec3> translation;
+	std::vector<glm::vec3> rotation;
+	std::vector<glm::vec3> scale;
+
+	// As of the last simulation tick, the renderer blends from these
+	std::vector<glm::vec3> previousTranslation;
+	std::vector<glm::vec3> previousRotation;
+	std::vector<glm::vec3> previousScale;
+
+	size_t size() const {return translation.size();}
+
+	TransformComponent Get(uint32_t i) const {return {translation[i], scale[i], rotation[i]};}
+	TransformComponent Previous(uint32_t i) const {return {previousTranslation[i], previousScale[i], previousRotation[i]};}
+};
+
+// Passes over a store of entities, see EntityStore::Benchmark. Times are for all of them at once.
+struct EntityBenchmark{
+	size_t entities = 0;
+	double createMs = 0.0;	// Create and SetRender
+	double moveMs = 0.0;	// SetTransform on every entity
+	double updateMs = 0.0;	// UpdateTransforms after the move
+	double renderMs = 0.0;	// RenderMatrices over every render component, all moved this tick
+	double snapshotMs = 0.0;	// SnapshotTransforms at the start of the next tick
+	double destroyMs = 0.0;	// Destroy on every other entity, the rest move into the holes
+};
+
+// Entities and their components in packed arrays. Every entity has a transform, those with a model
+// also have a RenderComponent. Destroy moves the last entry of each array into the hole, so systems
+// walk plain arrays with no gaps and handles find their entries through a table of slots.
+// Transforms are local to an optional parent. World and normal matrices are cached and only worked
+// out again by UpdateTransforms for entities whose transform or an ancestor's was set, so an entity
+// that doesn't move costs nothing per frame. TakeChanges hands what changed on to a system keeping
+// its own copy, such as the physics broadphase, so it need not walk the rest either.
+class EntityStore{
+public:
+
+	size_t size() const {return owners.size();}
+	uint32_t SlotCount() const {return static_cast<uint32_t>(slots.size());}
+
+	Entity Create(const TransformComponent& transform = {}) {
+		uint32_t index;
+		if (!freeSlots.empty()){
+			index = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else{
+			index = SlotCount();
+			slots.push_back({});
+		}
+		Slot& slot = slots[index];
+		slot.transform = static_cast<uint32_t>(owners.size());
+		slot.render = none;
+		Entity entity{index, slot.generation};
+		owners.push_back(entity);
+		PushTransform(transform);
+		return entity;
+	}
+
+	void Destroy(Entity entity) {
+		if (!Alive(entity)) return;
+		RemoveRender(entity);
+		SetParent(entity, Entity{});
+		while (slots[entity.index].firstChild != none) SetParent(Handle(slots[entity.index].firstChild), Entity{});
+		Slot& slot = slots[entity.index];
+		uint32_t hole = slot.transform, last = static_cast<uint32_t>(owners.size() - 1);
+		if (hole != last){
+			MoveTransform(last, hole);
+			owners[hole] = owners[last];
+			Slot& movedSlot = slots[owners[hole].index];
+			movedSlot.transform = hole;
+			if (movedSlot.render != none) renderables[movedSlot.render].transform = hole;
+		}
+		PopTransform();
+		owners.pop_back();
+		slot.generation++;
+		slot.transform = none;
+		freeSlots.push_back(entity.index);
+		freed.push_back(entity.index);
+	}
+
+	bool Alive(Entity entity) const {
+		return entity.index < slots.size() && slots[entity.index].generation == entity.generation && slots[entity.index].transform != none;
+	}
+
+	// The live entity using slot index, an invalid handle when the slot is free
+	Entity Handle(uint32_t index) const {
+		if (index >= slots.size() || slots[index].transform == none) return {};
+		return {index, slots[index].generation};
+	}
+
+	// TRANSFORMS //////////////////////////////////////////////////////////
+
+	// Read only, SetTransform marks what it changes
+	const TransformArrays& Transforms() const {return transforms;}
+
+	// Dense index of a live entity's transform, it changes when other entities are destroyed
+	uint32_t TransformIndex(Entity entity) const {return slots[entity.index].transform;}
+
+	// Entity owning the transform at a dense index
+	Entity Owner(uint32_t transform) const {return owners[transform];}
+
+	TransformComponent GetTransform(Entity entity) const {return transforms.Get(TransformIndex(entity));}
+
+	void SetTransform(Entity entity, const TransformComponent& transform) {
+		uint32_t i = TransformIndex(entity);
+		transforms.translation[i] = transform.translation;
+		transforms.rotation[i] = transform.rotation;
+		transforms.scale[i] = transform.scale;
+		Mark(i, Dirty, dirty);
+		Mark(i, Moved, moved);
+	}
+
+	// Transforms of child are then relative to parent, an invalid parent makes it a root. Refused
+	// when parent is child or one of its descendants.
+	bool SetParent(Entity child, Entity parent) {
+		if (!Alive(child) || (parent.valid() && !Alive(parent))) return false;
+		for (uint32_t ancestor = parent.index; parent.valid() && ancestor != none; ancestor = slots[ancestor].parent){
+			if (ancestor == child.index) return false;
+		}
+		Slot& slot = slots[child.index];
+		if (slot.parent != none){
+			uint32_t* link = &slots[slot.parent].firstChild;
+			while (*link != child.index) link = &slots[*link].nextSibling;
+			*link = slot.nextSibling;
+		}
+		slot.parent = parent.valid() ? parent.index : none;
+		slot.nextSibling = none;
+		if (parent.valid()){
+			slot.nextSibling = slots[parent.index].firstChild;
+			slots[parent.index].firstChild = child.index;
+		}
+		Mark(slot.transform, Dirty, dirty);
+		return true;
+	}
+
+	Entity GetParent(Entity entity) const {return Handle(slots[entity.index].parent);}
+
+	// Works out the world and normal matrices of every entity marked since the last call, and of
+	// everything below them, parents before children
+	void UpdateTransforms() {
+		for (Entity entity : dirty){
+			if (!Alive(entity) || !(flags[TransformIndex(entity)] & Dirty)) continue;
+			uint32_t top = entity.index;
+			for (uint32_t ancestor = slots[top].parent; ancestor != none; ancestor = slots[ancestor].parent){
+				if (flags[slots[ancestor].transform] & Dirty) top = ancestor;
+			}
+			UpdateSubtree(top);
+		}
+		dirty.clear();
+	}
+
+	// Entities whose world matrix or model changed and slots freed since the last call, for the one
+	// system keeping a copy of them. An entity destroyed meanwhile is only among the freed slots, a
+	// slot freed and taken again is in both, so apply the freed ones first.
+	void TakeChanges(std::vector<Entity>& changedEntities, std::vector<uint32_t>& freedSlots) {
+		changedEntities.clear();
+		for (Entity entity : changed){
+			if (!Alive(entity)) continue;
+			flags[TransformIndex(entity)] &= ~Changed;
+			changedEntities.push_back(entity);
+		}
+		changed.clear();
+		freedSlots.swap(freed);
+		freed.clear();
+	}
+
+	// As of the last UpdateTransforms
+	const glm::mat4& WorldMatrix(uint32_t transform) const {return world[transform];}
+	const glm::mat4& NormalMatrix(uint32_t transform) const {return normal[transform];}
+
+	// World and normal matrices alpha of the way through the last tick. The cached ones unless the
+	// entity or an ancestor moved during it.
+	void RenderMatrices(uint32_t transform, float alpha, glm::mat4& worldMatrix, glm::mat4& normalMatrix) const {
+		if (!MovedThisTick(transform)){
+			worldMatrix = world[transform];
+			normalMatrix = normal[transform];
+			return;
+		}
+		worldMatrix = InterpolatedWorld(transform, alpha);
+		normalMatrix = glm::transpose(glm::inverse(worldMatrix));
+	}
+
+	// Start of a simulation tick, the transforms set during the last one become the previous ones
+	void SnapshotTransforms() {
+		for (Entity entity : moved){
+			if (!Alive(entity)) continue;
+			uint32_t i = TransformIndex(entity);
+			transforms.previousTranslation[i] = transforms.translation[i];
+			transforms.previousRotation[i] = transforms.rotation[i];
+			transforms.previousScale[i] = transforms.scale[i];
+			flags[i] &= ~Moved;
+		}
+		moved.clear();
+	}
+
+	// RENDERING ///////////////////////////////////////////////////////////
+
+	// Every model drawn, shared by the entities using it. Models stay until Clear.
+	const std::vector<std::shared_ptr<EngineModel>>& Models() const {return models;}
+
+	const std::vector<RenderComponent>& Renderables() const {return renderables;}
+
+	// Entity owning the render component at a dense index
+	Entity RenderOwner(uint32_t render) const {return owners[renderables[render].transform];}
+
+	// Null without a render component
+	const RenderComponent* GetRender(Entity entity) const {
+		uint32_t render = slots[entity.index].render;
+		return render == none ? nullptr : &renderables[render];
+	}
+
+	void SetRender(Entity entity, const std::shared_ptr<EngineModel>& model, const glm::vec3& colour = glm::vec3(0.0f)) {
+		if (!Alive(entity)) return;
+		Slot& slot = slots[entity.index];
+		RenderComponent component{slot.transform, ModelIndex(model), colour};
+		Mark(slot.transform, Changed, changed);
+		if (slot.render != none){
+			renderables[slot.render] = component;
+			return;
+		}
+		slot.render = static_cast<uint32_t>(renderables.size());
+		renderables.push_back(component);
+	}
+
+	void RemoveRender(Entity entity) {
+		if (!Alive(entity)) return;
+		Slot& slot = slots[entity.index];
+		if (slot.render == none) return;
+		Mark(slot.transform, Changed, changed);
+		uint32_t last = static_cast<uint32_t>(renderables.size() - 1);
+		if (slot.render != last){
+			renderables[slot.render] = renderables[last];
+			slots[owners[renderables[slot.render].transform].index].render = slot.render;
+		}
+		renderables.pop_back();
+		slot.render = none;
+	}
+
+	// Destroys every entity and releases the models, handles from before stay dead
+	void Clear() {
+		for (uint32_t index = 0; index < SlotCount(); ++index) Destroy(Handle(index));
+		models.clear();
+		dirty.clear();
+		moved.clear();
+		changed.clear();
+	}
+
+	// Runs a tick's worth of each system over count entities in a store of its own, every one
+	// drawn and moved. The render components share one empty model, nothing is uploaded.
+	static EntityBenchmark Benchmark(size_t count = 100000) {
+		EntityBenchmark result;
+		result.entities = count;
+		EntityStore store;
+		std::vector<Entity> created(count);
+		std::shared_ptr<EngineModel> model;
+		auto start = std::chrono::steady_clock::now();
+		auto lap = [&start]() {
+			auto now = std::chrono::steady_clock::now();
+			double ms = std::chrono::duration<double, std::milli>(now - start).count();
+			start = now;
+			return ms;
+		};
+
+		for (size_t i = 0; i < count; ++i){
+			TransformComponent transform;
+			transform.translation = glm::vec3(i % 1000, (i / 1000) % 100, i / 100000);
+			created[i] = store.Create(transform);
+			store.SetRender(created[i], model);
+		}
+		store.UpdateTransforms();
+		result.createMs = lap();
+
+		for (size_t i = 0; i < count; ++i){
+			TransformComponent transform = store.GetTransform(created[i]);
+			transform.translation.y += 1.0f;
+			transform.rotation.y += 0.01f;
+			store.SetTransform(created[i], transform);
+		}
+		result.moveMs = lap();
+
+		store.UpdateTransforms();
+		result.updateMs = lap();
+
+		glm::mat4 worldMatrix, normalMatrix;
+		float checksum = 0.0f;
+		for (const RenderComponent& render : store.Renderables()){
+			store.RenderMatrices(render.transform, 0.5f, worldMatrix, normalMatrix);
+			checksum += worldMatrix[3][1];
+		}
+		result.renderMs = lap();
+
+		store.SnapshotTransforms();
+		result.snapshotMs = lap();
+
+		for (size_t i = 0; i < count; i += 2) store.Destroy(created[i]);
+		result.destroyMs = lap();
+
+		// Keeps the render walk from being optimised away
+		volatile float sink = checksum;
+		(void)sink;
+		return result;
+	}
+
+private:
+	static constexpr uint32_t none = ~0u;
+
+	// Per transform
+	enum Flag : uint8_t {
+		Dirty = 1,	// world matrix out of date, queued in dirty
+		Moved = 2,	// set since the tick started, queued in moved
+		Changed = 4,	// world matrix or model changed since TakeChanges, queued in changed
+	};
+
+	struct Slot{
+		uint32_t generation = 0;
+		uint32_t transform = none;	// none while the slot is free
+		uint32_t render = none;
+		uint32_t parent = none;	// slot indices
+		uint32_t firstChild = none;
+		uint32_t nextSibling = none;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<Entity> owners;	// parallel to the transform arrays
+	TransformArrays transforms;
+	std::vector<glm::mat4> world;	// parallel to the transform arrays
+	std::vector<glm::mat4> normal;
+	std::vector<uint8_t> flags;
+	std::vector<Entity> dirty;
+	std::vector<Entity> moved;
+	std::vector<Entity> changed;
+	std::vector<uint32_t> freed;	// slots, since TakeChanges
+	std::vector<RenderComponent> renderables;
+	std::vector<std::shared_ptr<EngineModel>> models;
+	std::vector<uint32_t> stack;	// UpdateSubtree's
+
+	void Mark(uint32_t transform, Flag flag, std::vector<Entity>& queue) {
+		if (flags[transform] & flag) return;
+		flags[transform] |= flag;
+		queue.push_back(owners[transform]);
+	}
+
+	bool MovedThisTick(uint32_t transform) const {
+		if (flags[transform] & Moved) return true;
+		for (uint32_t ancestor = slots[owners[transform].index].parent; ancestor != none; ancestor = slots[ancestor].parent){
+			if (flags[slots[ancestor].transform] & Moved) return true;
+		}
+		return false;
+	}
+
+	glm::mat4 InterpolatedWorld(uint32_t transform, float alpha) const {
+		glm::mat4 local = TransformComponent::interpolate(transforms.Previous(transform), transforms.Get(transform), alpha).mat4();
+		uint32_t parent = slots[owners[transform].index].parent;
+		return parent == none ? local : InterpolatedWorld(slots[parent].transform, alpha) * local;
+	}
+
+	// The entity at slot top and all below it, depth first so every parent is done before its children
+	void UpdateSubtree(uint32_t top) {
+		stack.clear();
+		stack.push_back(top);
+		while (!stack.empty()){
+			const Slot& slot = slots[stack.back()];
+			stack.pop_back();
+			uint32_t i = slot.transform;
+			glm::mat4 local = transforms.Get(i).mat4();
+			world[i] = slot.parent == none ? local : world[slots[slot.parent].transform] * local;
+			normal[i] = glm::transpose(glm::inverse(world[i]));
+			flags[i] &= ~Dirty;
+			Mark(i, Changed, changed);
+			for (uint32_t child = slot.firstChild; child != none; child = slots[child].nextSibling) stack.push_back(child);
+		}
+	}
+
+	uint32_t ModelIndex(const std::shared_ptr<EngineModel>& model) {
+		for (uint32_t i = 0; i < models.size(); ++i){
+			if (models[i] == model) return i;
+		}
+		models.push_back(model);
+		return static_cast<uint32_t>(models.size() - 1);
+	}
+
+	void PushTransform(const TransformComponent& transform) {
+		transforms.translation.push_back(transform.translation);
+		transforms.rotation.push_back(transform.rotation);
+		transforms.scale.push_back(transform.scale);
+		transforms.previousTranslation.push_back(transform.translation);
+		transforms.previousRotation.push_back(transform.rotation);
+		transforms.previousScale.push_back(transform.scale);
+		world.push_back(glm::mat4(1.0f));
+		normal.push_back(glm::mat4(1.0f));
+		flags.push_back(0);
+		Mark(static_cast<uint32_t>(flags.size() - 1), Dirty, dirty);
+	}
+
+	void MoveTransform(uint32_t from, uint32_t to) {
+		transforms.translation[to] = transforms.translation[from];
+		transforms.rotation[to] = transforms.rotation[from];
+		transforms.scale[to] = transforms.scale[from];
+		transforms.previousTranslation[to] = transforms.previousTranslation[from];
+		transforms.previousRotation[to] = transforms.previousRotation[from];
+		transforms.previousScale[to] = transforms.previousScale[from];
+		world[to] = world[from];
+		normal[to] = normal[from];
+		flags[to] = flags[from];
+	}
+
+	void PopTransform() {
+		transforms.translation.pop_back();
+		transforms.rotation.pop_back();
+		transforms.scale.pop_back();
+		transforms.previousTranslation.pop_back();
+		transforms.previousRotation.pop_back();
+		transforms.previousScale.pop_back();
+		world.pop_back();
+		normal.pop_back();
+		flags.pop_back();
+	}
+};
+
+} // namespace
+#endif
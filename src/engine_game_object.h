@@ -5,6 +5,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "../vendor/glm/glm.hpp"
 #include "../vendor/glm/gtc/matrix_transform.hpp"
+#include "../vendor/glm/gtc/constants.hpp"
 #include "engine_model.h"
 #include <memory>
 
@@ -17,7 +18,7 @@ struct TransformComponent {
 
 	// matrix corresponds to translate * Ry * Rx * Rz * scale transformation
 	// Rotation convention uses tait-bryan angles with axes order Y(1), X(2), Z(3)
-	glm::mat4 mat4() {
+	glm::mat4 mat4() const {
     const float c3 = glm::cos(rotation.z);
     const float s3 = glm::sin(rotation.z);
     const float c2 = glm::cos(rotation.x);
@@ -45,34 +46,16 @@ struct TransformComponent {
         },
         {translation.x, translation.y, translation.z, 1.0f}};
   }
-};
-
-class EngineGameObject {
-public:
-
-	using id_t = unsigned int;	
 
-	static EngineGameObject createGameObject(){
-		static id_t currentId = 0;
-		return EngineGameObject{currentId++};
+	// Part way from a to b. Angles blend per axis along the shorter way round, so one wrapped to a
+	// turn between ticks does not spin back, but keep the steps between ticks under half a turn.
+	static TransformComponent interpolate(const TransformComponent& a, const TransformComponent& b, float alpha) {
+		glm::vec3 turn = b.rotation - a.rotation;
+		turn -= glm::two_pi<float>() * glm::round(turn / glm::two_pi<float>());
+		return {glm::mix(a.translation, b.translation, alpha), glm::mix(a.scale, b.scale, alpha), a.rotation + turn * alpha};
 	}
-
-	EngineGameObject(const EngineGameObject &) = delete;
-	EngineGameObject &operator=(const EngineGameObject &) = delete;
-	EngineGameObject(EngineGameObject&&) = default;
-	EngineGameObject &operator=(EngineGameObject&&) = default;
-
-	const id_t getId() {return id;}
-
-	std::shared_ptr<EngineModel> model{};
-	glm::vec3 colour{};
-	TransformComponent transform;
-
-private:
-	EngineGameObject(id_t objId) : id{objId} {}
-
-	id_t id;
 };
+
 } // namespace
 
 #endif
\ No newline at end of file
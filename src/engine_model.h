@@ -2,6 +2,7 @@
 #define MODEL_H
 
 #include "engine_device.h"
+#include "engine_bvh.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -43,6 +44,11 @@ public:
 
 	EngineModel(EngineDevice& _engineDevice, const std::vector<Vertex> &vertices) : engineDevice{_engineDevice} {
 		creatVertexBuffers(vertices);
+
+		// Ray queries run against a copy of the positions, the buffer stays on the GPU
+		std::vector<glm::vec3> positions(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i) positions[i] = vertices[i].position;
+		bvh = TriangleBvh(positions);
 	}
 
 	~EngineModel(){
@@ -64,6 +70,8 @@ public:
 		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
 	}
 
+	const TriangleBvh& getBvh() const {return bvh;}
+
 
 private:
 
@@ -89,6 +97,7 @@ private:
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
 	uint32_t vertexCount; 
+	TriangleBvh bvh;
 };	
 } // namespace
 
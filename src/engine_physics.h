@@ -1,164 +1,457 @@
 #ifndef ENGINE_PHYSICS_H
 #define ENGINE_PHYSICS_H
 
-#include "Vector.h"
 #include "App.h"
-#include "engine_mesh.h"
 #include "engine_game_object.h"
+#include "engine_entities.h"
+#include "engine_bvh.h"
+#include "engine_broadphase.h"
+#include "terrain_model.h"
+#include "../terrain/terrain.h"
+#include <memory>
+#include <unordered_map>
 
 namespace Engine{
 
 
 class Ray {
 public:
-    Ray(const Vector3& _origin, const Vector3& _direction) : origin(_origin), direction(_direction) {}
+    Ray(const glm::vec3& _origin, const glm::vec3& _direction) : origin(_origin), direction(_direction) {}
 
-    Vector3 getOrigin() const { return origin; }
-    Vector3 getDirection() const { return direction; }
+    glm::vec3 getOrigin() const { return origin; }
+    glm::vec3 getDirection() const { return direction; }
 
-    void setOrigin(Vector3 newOrigin) { origin = newOrigin;}
-    void setDirection(Vector3 newDirection) { direction = newDirection; }
+    void setOrigin(glm::vec3 newOrigin) { origin = newOrigin;}
+    void setDirection(glm::vec3 newDirection) { direction = newDirection; }
 
 private:    
-    Vector3 origin, direction;  
+    glm::vec3 origin, direction;  
 };
 
 class RayHit {
     Ray ray;
-    Vector3 point;
-    Vector3 normal;
+    glm::vec3 point;
+    glm::vec3 normal;
     float distance;
     bool hit;
-    EngineGameObject* gameObject;
+    Entity entity;
+    glm::ivec2 chunk;
 
 public:
     RayHit(
-    Ray _ray = Ray(Vector3(0.0f,0.0f,0.0f), Vector3(0.0f,0.0f,0.0f)), 
-    Vector3 _point = Vector3(0.0f,0.0f,0.0f), 
+    Ray _ray = Ray(glm::vec3(0.0f), glm::vec3(0.0f)), 
+    glm::vec3 _point = glm::vec3(0.0f), 
     float _distance = std::numeric_limits<float>::infinity(), 
-    Vector3 _normal = Vector3(0.0f,0.0f,0.0f), 
+    glm::vec3 _normal = glm::vec3(0.0f), 
     bool _hit = false,
-    EngineGameObject* _gameObject = nullptr)
-    : ray(_ray), point(_point), distance(_distance), normal(_normal), hit(_hit), gameObject(_gameObject) {}
+    Entity _entity = Entity{},
+    glm::ivec2 _chunk = glm::ivec2(0))
+    : ray(_ray), point(_point), distance(_distance), normal(_normal), hit(_hit), entity(_entity), chunk(_chunk) {}
 
     Ray getRay() {return ray;}
-    Vector3 getPoint() const {return point;}
-    Vector3 getNormal() const {return normal;}
+    glm::vec3 getPoint() const {return point;}
+    glm::vec3 getNormal() const {return normal;}
     float getDistance() const {return distance;}
     bool didHit() const {return hit;}
-    EngineGameObject* getObjectPtr() const {return gameObject;}
+    Entity getEntity() const {return entity;}    // invalid unless an entity was hit
+    bool didHitTerrain() const {return hit && !entity.valid();}
+    glm::ivec2 getChunk() const {return chunk;}    // x and z of the chunk hit, see Terrain::FindChunkObject
 };
 
 
 
 
+// Upright capsule, moved against the terrain by Physics::MoveCapsule
+struct CapsuleCollider {
+    glm::vec3 position{0.0f};    // centre
+    float radius = 0.4f;
+    float height = 1.8f;    // end to end, at least twice the radius
+    bool grounded = false;    // rested on ground facing up during the last move
+};
+
+// Many rays at once, each component in its own array
+struct RayBatch {
+    const float* originX;
+    const float* originY;
+    const float* originZ;
+    const float* directionX;
+    const float* directionY;
+    const float* directionZ;
+    const float* maxDistance = nullptr;    // per ray, unlimited when null
+    size_t count = 0;
+};
+
+// Where RayCastBatch writes its hits, count entries each. Only distance is required.
+// A hit with an invalid entity is on the terrain chunk at chunk, like RayHit.
+struct RayBatchHits {
+    float* distance;    // infinity on a miss
+    float* normalX = nullptr;
+    float* normalY = nullptr;
+    float* normalZ = nullptr;
+    Entity* entity = nullptr;
+    glm::ivec2* chunk = nullptr;    // x and z of the chunk hit, see Terrain::FindChunkObject
+};
+
+// Ray queries against every entity with a model and every terrain chunk. Each model carries a TriangleBvh built
+// when it is created, a top level Bvh over their world bounds picks the models a ray can reach. An instance
+// keeps its matrices and bounds until its entity or chunk changes, and the top level is only rebuilt when
+// instances come or go and refitted when they move.
+// RayCastTerrain skips the meshes and walks the terrain's density instead.
+// Entities are also kept in a SpatialHashGrid under their slot index, the Overlap queries return
+// the candidates near a region without looking at the rest of the world.
 class Physics {
 public:
 
-    static RayHit RayCast(const Vector3& origin, const Vector3& direction) {
+    // Closest hit against the scene as of the last UpdateScene, distances are in units of direction
+    static RayHit RayCast(const glm::vec3& rayOrigin, const glm::vec3& rayDirection, float maxDistance = std::numeric_limits<float>::infinity()) {
+        Ray ray(rayOrigin, rayDirection);
+
+        float closestHitDistance = maxDistance;
+        TriangleBvh::Hit closestHit;
+        int64_t instance = scene.Closest(rayOrigin, rayDirection, closestHitDistance, [&](uint32_t i, float closest){
+            // The ray moves into model space unnormalised, so distances carry over unchanged
+            const Instance& candidate = instances[i];
+            glm::vec3 localOrigin = glm::vec3(candidate.toLocal * glm::vec4(rayOrigin, 1.0f));
+            glm::vec3 localDirection = glm::vec3(candidate.toLocal * glm::vec4(rayDirection, 0.0f));
+            TriangleBvh::Hit hit = candidate.bvh->Intersect(localOrigin, localDirection, closest);
+            if (hit.hit()) closestHit = hit;
+            return hit.distance;
+        });
+        if (instance < 0) return RayHit(ray);
+
+        const Instance& hitInstance = instances[instance];
+        glm::vec3 point = rayOrigin + rayDirection * closestHitDistance;
+        glm::vec3 normal = glm::normalize(hitInstance.normalToWorld * closestHit.normal);
+        return RayHit(ray, point, closestHitDistance, normal, true, hitInstance.entity, hitInstance.chunk);
+    }
 
-        float closestHitDistance = std::numeric_limits<float>::infinity();
-        RayHit returnHit;
+    // RayCast over a batch, four rays at a time traced down both levels of the hierarchy together.
+    // Nothing is allocated per ray, rays going the same way share most of the nodes they open.
+    static void RayCastBatch(const RayBatch& rays, const RayBatchHits& hits) {
+        for (size_t first = 0; first < rays.count; first += 4) {
+            // Lanes past the end get a negative distance and take no part
+            float lanes[7][4];
+            for (int lane = 0; lane < 4; ++lane) {
+                size_t i = first + lane;
+                bool active = i < rays.count;
+                lanes[0][lane] = active ? rays.originX[i] : 0.0f;
+                lanes[1][lane] = active ? rays.originY[i] : 0.0f;
+                lanes[2][lane] = active ? rays.originZ[i] : 0.0f;
+                lanes[3][lane] = active ? rays.directionX[i] : 1.0f;
+                lanes[4][lane] = active ? rays.directionY[i] : 1.0f;
+                lanes[5][lane] = active ? rays.directionZ[i] : 1.0f;
+                lanes[6][lane] = !active ? -1.0f : rays.maxDistance ? rays.maxDistance[i] : std::numeric_limits<float>::infinity();
+            }
+            RayPacket packet({Float4::Load(lanes[0]), Float4::Load(lanes[1]), Float4::Load(lanes[2])},
+                {Float4::Load(lanes[3]), Float4::Load(lanes[4]), Float4::Load(lanes[5])});
+            Float4 distance = Float4::Load(lanes[6]);
+
+            int64_t hitInstances[4] = {-1, -1, -1, -1};
+            int64_t hitTriangles[4] = {-1, -1, -1, -1};
+            scene.ClosestPacket(packet, distance, [&](uint32_t i, Float4& closest){
+                int64_t triangles[4] = {-1, -1, -1, -1};
+                instances[i].bvh->IntersectPacket(packet.Transformed(instances[i].toLocal), closest, triangles);
+                for (int lane = 0; lane < 4; ++lane) {
+                    if (triangles[lane] < 0) continue;
+                    hitInstances[lane] = i;
+                    hitTriangles[lane] = triangles[lane];
+                }
+            });
+
+            float distances[4];
+            distance.Store(distances);
+            for (int lane = 0; lane < 4 && first + lane < rays.count; ++lane) {
+                size_t i = first + lane;
+                const Instance* hitInstance = hitInstances[lane] >= 0 ? &instances[hitInstances[lane]] : nullptr;
+                hits.distance[i] = hitInstance ? distances[lane] : std::numeric_limits<float>::infinity();
+                if (hits.normalX) {
+                    glm::vec3 normal = hitInstance ? glm::normalize(hitInstance->normalToWorld * hitInstance->bvh->Normal(hitTriangles[lane])) : glm::vec3(0.0f);
+                    hits.normalX[i] = normal.x;
+                    hits.normalY[i] = normal.y;
+                    hits.normalZ[i] = normal.z;
+                }
+                if (hits.entity) hits.entity[i] = hitInstance ? hitInstance->entity : Entity{};
+                if (hits.chunk) hits.chunk[i] = hitInstance ? hitInstance->chunk : glm::ivec2(0);
+            }
+        }
+    }
 
-        // For each gameobject check intersection with each face
-        for (EngineGameObject* gameObject : gameObjects) {
+    // Closest hit on the terrain's isosurface, see Terrain::RayCastDensity. Chunks count whether
+    // or not their meshes are uploaded.
+    static RayHit RayCastTerrain(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = std::numeric_limits<float>::infinity()) {
+        Ray ray(origin, direction);
+        if (!terrain) return RayHit(ray);
 
-            std::shared_ptr<Mesh> mesh = gameObject->getMesh();
+        Terrain::DensityHit hit = terrain->RayCastDensity(origin, direction, maxDistance);
+        if (!hit.hit) return RayHit(ray);
+        return RayHit(ray, hit.point, hit.distance, hit.normal, true, Entity{}, hit.chunk);
+    }
 
-            std::vector<Mesh::Vertex> vertices = mesh->getVertices();
-            std::vector<uint32_t> indices = mesh->getIndices();
+    // Entities are read again by every UpdateScene as they are created, moved and destroyed. The
+    // store's changes go to the broadphase and the scene from then on, see EntityStore::TakeChanges.
+    void SetEntities(EntityStore* _entities){
+        for (uint32_t slot = 0; slot < entityInstances.size(); ++slot) RemoveEntityInstance(slot);
+        entities = _entities;
+        broadphase.Clear();
+        entities->TakeChanges(changedEntities, freedSlots);
+        for (uint32_t slot = 0; slot < entities->SlotCount(); ++slot) {
+            Entity entity = entities->Handle(slot);
+            if (entity.valid()) UpdateEntity(entity);
+        }
+    }
 
-            // No index buffer
-            if (indices.size() == 0){
-                for (size_t i = 0; i < vertices.size(); i += 3) { // Loop over vertices
+    // Entities whose bounds overlap the box, as of the last UpdateScene
+    static void OverlapBox(const Aabb& box, std::vector<Entity>& result) {
+        broadphase.QueryBox(box, candidates);
+        GatherCandidates(result);
+    }
 
-                    Mesh::Vertex& vert1 = vertices[i];
-                    Mesh::Vertex& vert2 = vertices[i + 1];
-                    Mesh::Vertex& vert3 = vertices[i + 2];
+    // Entities whose bounds come within radius of centre
+    static void OverlapSphere(const glm::vec3& centre, float radius, std::vector<Entity>& result) {
+        broadphase.QuerySphere(centre, radius, candidates);
+        GatherCandidates(result);
+    }
 
-                    Vector3 v1(vert1.position.x, vert1.position.y, vert1.position.z);
-                    Vector3 v2(vert2.position.x, vert2.position.y, vert2.position.z);
-                    Vector3 v3(vert3.position.x, vert3.position.y, vert3.position.z);
+    // Entities whose bounds the ray enters before maxDistance, for a RayCast of its own
+    static void OverlapRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<Entity>& result) {
+        broadphase.QueryRay(origin, direction, maxDistance, candidates);
+        GatherCandidates(result);
+    }
 
-                    Ray ray(origin, direction);
-                    RayHit hit = RayTriangleIntersect(ray, gameObject, v1, v2, v3);
+    // Every pair of entities whose bounds overlap, the candidates for entity to entity contacts
+    static void OverlappingPairs(std::vector<std::pair<Entity, Entity>>& result) {
+        broadphase.OverlappingPairs(candidatePairs);
+        result.clear();
+        for (const auto& [a, b] : candidatePairs) result.push_back({entities->Handle(a), entities->Handle(b)});
+    }
 
-                    if (hit.getDistance() < closestHitDistance){
-                        closestHitDistance = hit.getDistance();
-                        returnHit = hit;
-                    }
-                }
-            }
-            else
-            {
-                // Loop over the indices of the builder
-                for (size_t i = 0; i < indices.size(); i += 3) { // Loop over indices
-
-                    Mesh::Vertex& vert1 = vertices[indices[i]];
-                    Mesh::Vertex& vert2 = vertices[indices[i + 1]];
-                    Mesh::Vertex& vert3 = vertices[indices[i + 2]];
-
-                    Vector3 v1(vert1.position.x, vert1.position.y, vert1.position.z);
-                    Vector3 v2(vert2.position.x, vert2.position.y, vert2.position.z);
-                    Vector3 v3(vert3.position.x, vert3.position.y, vert3.position.z);
-
-                    Ray ray(origin, direction);
-                    RayHit hit = RayTriangleIntersect(ray, gameObject, v1, v2, v3);
-
-                    if (hit.getDistance() < closestHitDistance){
-                        closestHitDistance = hit.getDistance();
-                        returnHit = hit;
-                    }
+    // Sweeps the capsule by displacement and slides it along the terrain it touches. The move is cut
+    // into steps of half the radius so it cannot pass through a thin wall. After every step the
+    // spheres along the capsule's axis are pushed out of the surface by the terrain's approximate
+    // signed distance, and the rest of the move loses its part going into the surface.
+    // Chunks that are not resident do not collide.
+    static void MoveCapsule(CapsuleCollider& capsule, const glm::vec3& displacement) {
+        glm::vec3 position = capsule.position;
+        glm::vec3 move = displacement;
+        capsule.grounded = false;
+        if (!terrain) {
+            capsule.position = position + move;
+            return;
+        }
+
+        // Spheres no further apart than the radius cover the capsule's sides
+        float halfAxis = std::max(capsule.height * 0.5f - capsule.radius, 0.0f);
+        int spheres = static_cast<int>(std::ceil(2.0f * halfAxis / capsule.radius)) + 1;
+        int steps = std::max(1, static_cast<int>(std::ceil(glm::length(move) / (capsule.radius * 0.5f))));
+        glm::vec3 step = move / static_cast<float>(steps);
+
+        const Terrain::Chunk* chunk = nullptr;
+        for (int s = 0; s < steps; ++s) {
+            position += step;
+            for (int iteration = 0; iteration < maxCapsuleIterations; ++iteration) {
+                bool pushed = false;
+                for (int i = 0; i < spheres; ++i) {
+                    float along = spheres > 1 ? -halfAxis + 2.0f * halfAxis * i / (spheres - 1) : 0.0f;
+                    float distance;
+                    glm::vec3 normal;
+                    if (!terrain->SurfaceDistance(position + glm::vec3(0.0f, along, 0.0f), distance, normal, chunk) || distance >= capsule.radius) continue;
+                    position += normal * (capsule.radius - distance);
+                    step -= normal * std::min(glm::dot(step, normal), 0.0f);
+                    if (normal.y > groundNormalY) capsule.grounded = true;
+                    pushed = true;
                 }
+                if (!pushed) break;
             }
         }
-        return returnHit; // Return the closest hit result
+        capsule.position = position;
     }
 
-    void SetGameObjectPtrs(std::vector<EngineGameObject*> _gameObjects){
-        gameObjects = _gameObjects;
+    // Chunk objects are read again by every UpdateScene as chunks stream in and out
+    void SetTerrain(Terrain* _terrain){
+        terrain = _terrain;
     }
 
+    // Rebuilds the top level over the current models and the world matrices of the last
+    // EntityStore::UpdateTransforms, once a frame after they change.
+    // Only the entities the store changed since and the chunks whose model or placement changed are
+    // looked at again, entities move in the broadphase only when they leave the cells they covered.
+    static void UpdateScene() {
+        if (entities) {
+            entities->TakeChanges(changedEntities, freedSlots);
+            for (uint32_t slot : freedSlots) {
+                broadphase.Remove(slot);
+                RemoveEntityInstance(slot);
+            }
+            for (Entity entity : changedEntities) UpdateEntity(entity);
+        }
+        UpdateChunks();
 
-private:
-    static std::vector<EngineGameObject*> gameObjects;
-
-    static RayHit RayTriangleIntersect(const Ray& ray, EngineGameObject* gameObject, const Vector3& vertex1, const Vector3& vertex2, const Vector3& vertex3) {
-        Vector3 edge1 = vertex2 - vertex1;
-        Vector3 edge2 = vertex3 - vertex1;
-
-        Vector3 p = ray.getDirection().crossProduct(edge2);
-        float determinant = edge1.dotProduct(p);
+        if (rebuildScene) scene.Build(instanceBounds);
+        else if (refitScene) scene.Refit(instanceBounds);
+        rebuildScene = refitScene = false;
+    }
 
-        if (determinant == 0.0)
-            return RayHit(ray);
 
-        float invDeterminant = 1.0 / determinant;
+private:
 
-        Vector3 origin = ray.getOrigin() - vertex1;
-        float u = origin.dotProduct(p) * invDeterminant;
+    // Bounds are in instanceBounds, the top level's boxes
+    struct Instance {
+        std::shared_ptr<const void> owner;    // keeps the BVH alive while it is in the scene, a chunk's tree without its buffers
+        const TriangleBvh* bvh;
+        glm::mat4 toLocal;
+        glm::mat3 normalToWorld;
+        Entity entity;    // invalid for a terrain chunk
+        glm::ivec2 chunk;    // x and z of a terrain chunk, chunk objects move as chunks stream
+    };
+
+    // What a chunk's instance was made from, to tell when it is out of date
+    struct ChunkInstance {
+        uint32_t instance;
+        const TriangleBvh* bvh;
+        Aabb bounds;    // the tree's, writes refit it in place
+        glm::mat4 toWorld;
+        uint64_t seen;    // UpdateChunks pass that last found the chunk resident
+    };
+
+    static constexpr uint32_t noInstance = ~0u;
+
+    static constexpr int maxCapsuleIterations = 3;    // push outs per step, corners need more than one
+    static constexpr float groundNormalY = 0.7f;    // steepest ground a capsule rests on, about 45 degrees
+
+    static EntityStore* entities;
+    static Terrain* terrain;
+    static std::vector<Instance> instances;
+    static std::vector<Aabb> instanceBounds;    // parallel to instances
+    static std::vector<uint32_t> entityInstances;    // by slot, noInstance without a model
+    static std::unordered_map<uint64_t, ChunkInstance> chunkInstances;    // by ChunkKey
+    static uint64_t chunkPass;
+    static bool rebuildScene, refitScene;    // instances came or went, or moved, since the top level was last made
+    static Bvh scene;
+    static SpatialHashGrid broadphase;
+    static std::vector<uint32_t> candidates;
+    static std::vector<std::pair<uint32_t, uint32_t>> candidatePairs;
+    static std::vector<Entity> changedEntities;    // UpdateScene's
+    static std::vector<uint32_t> freedSlots;
+
+    // An entity the store changed, in the broadphase at its slot and in the scene when it has a model
+    static void UpdateEntity(Entity entity) {
+        broadphase.Set(entity.index, WorldBounds(entity));
+        const RenderComponent* render = entities->GetRender(entity);
+        if (!render || entities->Models()[render->model]->getBvh().empty()) {
+            RemoveEntityInstance(entity.index);
+            return;
+        }
+        if (entity.index >= entityInstances.size()) entityInstances.resize(entity.index + 1, noInstance);
+        const std::shared_ptr<EngineModel>& model = entities->Models()[render->model];
+        SetInstance(entityInstances[entity.index], model, model->getBvh(), entities->WorldMatrix(entities->TransformIndex(entity)), entity, glm::ivec2(0));
+    }
 
-        if (u < 0.0 || u > 1.0)
-            return RayHit(ray);
+    static void RemoveEntityInstance(uint32_t slot) {
+        if (slot >= entityInstances.size() || entityInstances[slot] == noInstance) return;
+        RemoveInstance(entityInstances[slot]);
+        entityInstances[slot] = noInstance;
+    }
 
-        Vector3 q = origin.crossProduct(edge1);
-        float v = ray.getDirection().dotProduct(q) * invDeterminant;
+    // Chunks with a model whose tree, its bounds or the chunk's matrix changed are placed again,
+    // chunks no longer resident leave the scene
+    static void UpdateChunks() {
+        chunkPass++;
+        size_t resident = 0;
+        for (size_t i = 0; terrain && i < terrain->chunkObjects.size(); ++i) {
+            const TerrainObject& terrainObject = terrain->chunkObjects[i];
+            if (!terrainObject.model || terrainObject.model->getBvh().empty()) continue;
+            resident++;
+            glm::ivec2 position = terrain->GetChunkPosition(i);
+            auto found = chunkInstances.try_emplace(ChunkKey(position), ChunkInstance{noInstance});
+            ChunkInstance& chunk = found.first->second;
+            chunk.seen = chunkPass;
+            const TriangleBvh& bvh = terrainObject.model->getBvh();
+            if (chunk.instance != noInstance && chunk.bvh == &bvh && chunk.bounds.min == bvh.Bounds().min && chunk.bounds.max == bvh.Bounds().max && chunk.toWorld == terrainObject.getMatrix()) continue;
+            chunk.bvh = &bvh;
+            chunk.bounds = bvh.Bounds();
+            chunk.toWorld = terrainObject.getMatrix();
+            SetInstance(chunk.instance, terrainObject.model->shareBvh(), bvh, chunk.toWorld, Entity{}, position);
+        }
+        if (chunkInstances.size() == resident) return;
+        for (auto chunk = chunkInstances.begin(); chunk != chunkInstances.end();) {
+            if (chunk->second.seen == chunkPass) {
+                ++chunk;
+                continue;
+            }
+            if (chunk->second.instance != noInstance) RemoveInstance(chunk->second.instance);
+            chunk = chunkInstances.erase(chunk);
+        }
+    }
 
-        if (v < 0.0 || u + v > 1.0)
-            return RayHit(ray);
+    static uint64_t ChunkKey(const glm::ivec2& position) {
+        return static_cast<uint64_t>(static_cast<uint32_t>(position.x)) << 32 | static_cast<uint32_t>(position.y);
+    }
 
-        float dist = edge2.dotProduct(q) * invDeterminant;
+    // The model's bounds placed in the world, a point at the origin of the entity without a model
+    static Aabb WorldBounds(Entity entity) {
+        const glm::mat4& world = entities->WorldMatrix(entities->TransformIndex(entity));
+        const RenderComponent* render = entities->GetRender(entity);
+        if (!render || entities->Models()[render->model]->getBvh().empty()) return Aabb{glm::vec3(world[3]), glm::vec3(world[3])};
+        return entities->Models()[render->model]->getBvh().Bounds().Transformed(world);
+    }
 
-        if (dist < 0.0)
-            return RayHit(ray);
+    static void GatherCandidates(std::vector<Entity>& result) {
+        result.clear();
+        for (uint32_t slot : candidates) result.push_back(entities->Handle(slot));
+    }
 
-        Vector3 intersectionPos = ray.getOrigin() + ray.getDirection() * dist;
-        Vector3 faceNormal = edge1.crossProduct(edge2).normalized();
+    // Places the instance at index, added at the end when index is noInstance
+    static void SetInstance(uint32_t& index, std::shared_ptr<const void> owner, const TriangleBvh& bvh, const glm::mat4& toWorld, Entity entity, glm::ivec2 chunk) {
+        Instance instance{
+            std::move(owner),
+            &bvh,
+            glm::inverse(toWorld),
+            glm::transpose(glm::inverse(glm::mat3(toWorld))),
+            entity,
+            chunk};
+        Aabb bounds = bvh.Bounds().Transformed(toWorld);
+        if (index == noInstance) {
+            index = static_cast<uint32_t>(instances.size());
+            instances.push_back(std::move(instance));
+            instanceBounds.push_back(bounds);
+            rebuildScene = true;
+            return;
+        }
+        instances[index] = std::move(instance);
+        instanceBounds[index] = bounds;
+        refitScene = true;
+    }
 
-        return RayHit(ray, intersectionPos, dist, faceNormal, true, gameObject);
+    // The last instance moves into the hole
+    static void RemoveInstance(uint32_t index) {
+        uint32_t last = static_cast<uint32_t>(instances.size() - 1);
+        if (index != last) {
+            instances[index] = std::move(instances[last]);
+            instanceBounds[index] = instanceBounds[last];
+            const Instance& moved = instances[index];
+            if (moved.entity.valid()) entityInstances[moved.entity.index] = index;
+            else chunkInstances[ChunkKey(moved.chunk)].instance = index;
+        }
+        instances.pop_back();
+        instanceBounds.pop_back();
+        rebuildScene = true;
     }
 };
-std::vector<EngineGameObject*> Physics::gameObjects;
+EntityStore* Physics::entities = nullptr;
+Terrain* Physics::terrain = nullptr;
+std::vector<Physics::Instance> Physics::instances;
+std::vector<Aabb> Physics::instanceBounds;
+std::vector<uint32_t> Physics::entityInstances;
+std::unordered_map<uint64_t, Physics::ChunkInstance> Physics::chunkInstances;
+uint64_t Physics::chunkPass = 0;
+bool Physics::rebuildScene = false;
+bool Physics::refitScene = false;
+Bvh Physics::scene;
+SpatialHashGrid Physics::broadphase;
+std::vector<uint32_t> Physics::candidates;
+std::vector<std::pair<uint32_t, uint32_t>> Physics::candidatePairs;
+std::vector<Entity> Physics::changedEntities;
+std::vector<uint32_t> Physics::freedSlots;
 } // namespace
 
 
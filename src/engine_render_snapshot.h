@@ -0,0 +1,168 @@
+#ifndef ENGINE_RENDER_SNAPSHOT_H
+#define ENGINE_RENDER_SNAPSHOT_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "camera.h"
+#include "engine_bvh.h"
+#include "engine_model.h"
+#include "terrain_model.h"
+#include "../terrain/terrain_settings.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+
+namespace Engine{
+
+// The six planes of a projection * view matrix, normals pointing inside. Depth runs 0 to 1.
+struct Frustum{
+	glm::vec4 planes[6];
+
+	explicit Frustum(const glm::mat4& projectionView) {
+		glm::mat4 rows = glm::transpose(projectionView);
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[2];
+		planes[5] = rows[3] - rows[2];
+	}
+
+	// False only when the box is wholly outside one plane, boxes near a corner may pass
+	bool Intersects(const Aabb& box) const {
+		for (const glm::vec4& plane : planes){
+			glm::vec3 normal{plane};
+			glm::vec3 farthest = glm::mix(box.min, box.max, glm::greaterThan(normal, glm::vec3(0.0f)));
+			if (glm::dot(normal, farthest) + plane.w < 0.0f) return false;
+		}
+		return true;
+	}
+
+	// Intersects for count boxes, four at a time, visible[i] is 1 when box i passes
+	void Intersects(const Aabb* boxes, size_t count, uint8_t* visible) const {
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4){
+			float lanes[6][4];
+			for (int lane = 0; lane < 4; ++lane){
+				for (int axis = 0; axis < 3; ++axis){
+					lanes[axis][lane] = boxes[i + lane].min[axis];
+					lanes[axis + 3][lane] = boxes[i + lane].max[axis];
+				}
+			}
+			Vector4x3 min{Float4::Load(lanes[0]), Float4::Load(lanes[1]), Float4::Load(lanes[2])};
+			Vector4x3 max{Float4::Load(lanes[3]), Float4::Load(lanes[4]), Float4::Load(lanes[5])};
+			Float4 outside;
+			for (const glm::vec4& plane : planes){
+				// Summed in the order the single box test sums, so both agree on boxes touching a plane
+				Float4 farthest[3];
+				for (int axis = 0; axis < 3; ++axis) farthest[axis] = Float4(plane[axis]) * (plane[axis] > 0.0f ? max[axis] : min[axis]);
+				Float4 distance = farthest[0] + farthest[1] + farthest[2] + Float4(plane.w);
+				outside = outside | (distance < Float4(0.0f));
+			}
+			int bits = outside.Bits();
+			for (int lane = 0; lane < 4; ++lane) visible[i + lane] = !(bits & (1 << lane));
+		}
+		for (; i < count; ++i) visible[i] = Intersects(boxes[i]);
+	}
+};
+
+// Everything one frame draws, built by the simulation thread and left alone once published. The
+// render thread reads it while the next is built, its models stay alive as long as it does.
+// Terrain models are written in place between frames, so the snapshot carries the buffer each
+// draws, which is left alone until the snapshot's serial retires (see TerrainModel::drawBuffer).
+struct RenderSnapshot{
+	struct Object{
+		EngineModel* model;	// one of models
+		glm::mat4 meshMatrix{1.0f};
+		glm::mat4 normalMatrix{1.0f};
+	};
+
+	uint64_t serial = 0;	// see SnapshotSerials
+	Camera camera;
+	float frameTime = 0.0f;
+	TerrainSettings terrainSettings;
+	std::vector<std::shared_ptr<EngineModel>> models;	// the entities' model table
+	std::vector<Object> objects;	// in view
+	std::vector<TerrainObject> chunks;	// in view, with a model
+	std::vector<VkBuffer> chunkBuffers;	// parallel to chunks
+	TerrainObject horizon;
+	VkBuffer horizonBuffer{};
+	int horizonRingCells = 0;	// HorizonClipmap::getRingCells, the horizon morphs by it
+
+	// Adds the models drawn to retained, to keep them until the GPU is done with the frame
+	void RetainModels(std::vector<std::shared_ptr<const void>>& retained) const {
+		for (const auto& model : models) retained.push_back(model);
+		for (const TerrainObject& chunk : chunks) retained.push_back(chunk.model);
+		if (horizon.model) retained.push_back(horizon.model);
+	}
+};
+
+// Passes values from one producer thread to one consumer thread through three slots. The producer
+// fills the back slot, the consumer reads the front one and the middle holds the newest published,
+// so publishing never waits for the consumer to finish reading and the consumer always gets the
+// latest. A value published before the last was taken is dropped.
+template <typename T>
+class TripleBuffer{
+public:
+
+	// Producer, the slot to fill next
+	T& Back() {return slots[back];}
+
+	void Publish() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::swap(back, middle);
+		fresh = true;
+		changed.notify_all();
+	}
+
+	// Producer, true once the consumer has taken the last Publish. False when timeout passes first or
+	// the buffer is closed, so the producer can keep its own thread responsive while it waits.
+	template <typename Rep, typename Period>
+	bool WaitTaken(std::chrono::duration<Rep, Period> timeout) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return changed.wait_for(lock, timeout, [&]{return !fresh || closed;}) && !closed;
+	}
+
+	// Consumer, waits for a value newer than the front one and makes it the front. False once the
+	// buffer is closed.
+	bool Acquire() {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]{return fresh || closed;});
+		if (closed) return false;
+		std::swap(front, middle);
+		fresh = false;
+		changed.notify_all();
+		return true;
+	}
+
+	// Consumer, the value last acquired
+	const T& Front() const {return slots[front];}
+
+	// Either side, wakes both and ends the exchange
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		changed.notify_all();
+	}
+
+	bool Closed() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return closed;
+	}
+
+private:
+	T slots[3];
+	int back = 0, middle = 1, front = 2;
+	bool fresh = false;	// middle holds a value the consumer hasn't taken
+	bool closed = false;
+	std::mutex mutex;
+	std::condition_variable changed;
+};
+
+} // namespace
+#endif
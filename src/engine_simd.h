@@ -0,0 +1,185 @@
+#ifndef ENGINE_SIMD_H
+#define ENGINE_SIMD_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define ENGINE_SIMD_SSE 0
+#include <cstring>
+#endif
+
+namespace Engine{
+
+// Four floats operated on together, SSE where the target has it and plain loops otherwise.
+// Comparisons return masks with every bit of a true lane set, Select and Bits read them.
+struct Float4{
+#if ENGINE_SIMD_SSE
+	__m128 v;
+
+	Float4() : v{_mm_setzero_ps()} {}
+	Float4(__m128 _v) : v{_v} {}
+	explicit Float4(float value) : v{_mm_set1_ps(value)} {}
+
+	static Float4 Load(const float* p) {return _mm_loadu_ps(p);}
+	void Store(float* p) const {_mm_storeu_ps(p, v);}
+
+	Float4 operator+(Float4 o) const {return _mm_add_ps(v, o.v);}
+	Float4 operator-(Float4 o) const {return _mm_sub_ps(v, o.v);}
+	Float4 operator*(Float4 o) const {return _mm_mul_ps(v, o.v);}
+	Float4 operator/(Float4 o) const {return _mm_div_ps(v, o.v);}
+	Float4 operator&(Float4 o) const {return _mm_and_ps(v, o.v);}
+	Float4 operator|(Float4 o) const {return _mm_or_ps(v, o.v);}
+	Float4 operator<(Float4 o) const {return _mm_cmplt_ps(v, o.v);}
+	Float4 operator<=(Float4 o) const {return _mm_cmple_ps(v, o.v);}
+	Float4 operator>(Float4 o) const {return _mm_cmpgt_ps(v, o.v);}
+	Float4 operator>=(Float4 o) const {return _mm_cmpge_ps(v, o.v);}
+	Float4 operator!=(Float4 o) const {return _mm_cmpneq_ps(v, o.v);}
+
+	static Float4 Min(Float4 a, Float4 b) {return _mm_min_ps(a.v, b.v);}
+	static Float4 Max(Float4 a, Float4 b) {return _mm_max_ps(a.v, b.v);}
+	static Float4 Select(Float4 mask, Float4 a, Float4 b) {return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));}
+
+	// Lane i of a mask is bit i
+	int Bits() const {return _mm_movemask_ps(v);}
+#else
+	float v[4];
+
+	Float4() : v{0.0f, 0.0f, 0.0f, 0.0f} {}
+	explicit Float4(float value) : v{value, value, value, value} {}
+
+	static Float4 Load(const float* p) {Float4 r; std::memcpy(r.v, p, sizeof(r.v)); return r;}
+	void Store(float* p) const {std::memcpy(p, v, sizeof(v));}
+
+	template <typename Op>
+	static Float4 Map(const Float4& a, const Float4& b, Op op) {Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = op(a.v[i], b.v[i]); return r;}
+	static float MaskOf(bool b) {float f; uint32_t bits = b ? 0xffffffffu : 0u; std::memcpy(&f, &bits, sizeof(f)); return f;}
+	static uint32_t BitsOf(float f) {uint32_t bits; std::memcpy(&bits, &f, sizeof(f)); return bits;}
+
+	Float4 operator+(Float4 o) const {return Map(*this, o, [](float a, float b){return a + b;});}
+	Float4 operator-(Float4 o) const {return Map(*this, o, [](float a, float b){return a - b;});}
+	Float4 operator*(Float4 o) const {return Map(*this, o, [](float a, float b){return a * b;});}
+	Float4 operator/(Float4 o) const {return Map(*this, o, [](float a, float b){return a / b;});}
+	Float4 operator&(Float4 o) const {return Map(*this, o, [](float a, float b){float f; uint32_t bits = BitsOf(a) & BitsOf(b); std::memcpy(&f, &bits, sizeof(f)); return f;});}
+	Float4 operator|(Float4 o) const {return Map(*this, o, [](float a, float b){float f; uint32_t bits = BitsOf(a) | BitsOf(b); std::memcpy(&f, &bits, sizeof(f)); return f;});}
+	Float4 operator<(Float4 o) const {return Map(*this, o, [](float a, float b){return MaskOf(a < b);});}
+	Float4 operator<=(Float4 o) const {return Map(*this, o, [](float a, float b){return MaskOf(a <= b);});}
+	Float4 operator>(Float4 o) const {return Map(*this, o, [](float a, float b){return MaskOf(a > b);});}
+	Float4 operator>=(Float4 o) const {return Map(*this, o, [](float a, float b){return MaskOf(a >= b);});}
+	Float4 operator!=(Float4 o) const {return Map(*this, o, [](float a, float b){return MaskOf(a != b);});}
+
+	// Like minps and maxps, the second operand when either is NaN
+	static Float4 Min(Float4 a, Float4 b) {return Map(a, b, [](float x, float y){return x < y ? x : y;});}
+	static Float4 Max(Float4 a, Float4 b) {return Map(a, b, [](float x, float y){return x > y ? x : y;});}
+	static Float4 Select(Float4 mask, Float4 a, Float4 b) {Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = BitsOf(mask.v[i]) ? a.v[i] : b.v[i]; return r;}
+
+	int Bits() const {int bits = 0; for (int i = 0; i < 4; ++i) bits |= (BitsOf(v[i]) >> 31) << i; return bits;}
+#endif
+
+	float Lane(int i) const {float lanes[4]; Store(lanes); return lanes[i];}
+};
+
+// Three components of four vectors, one Float4 per axis
+struct Vector4x3{
+	Float4 x, y, z;
+
+	Float4& operator[](int axis) {return axis == 0 ? x : axis == 1 ? y : z;}
+	const Float4& operator[](int axis) const {return axis == 0 ? x : axis == 1 ? y : z;}
+
+	Vector4x3 operator+(const Vector4x3& o) const {return {x + o.x, y + o.y, z + o.z};}
+	Vector4x3 operator-(const Vector4x3& o) const {return {x - o.x, y - o.y, z - o.z};}
+
+	static Float4 Dot(const Vector4x3& a, const Vector4x3& b) {return a.x * b.x + a.y * b.y + a.z * b.z;}
+	static Vector4x3 Cross(const Vector4x3& a, const Vector4x3& b) {
+		return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+	}
+
+	// Four packed xyz points, twelve floats, split into their axes
+	static Vector4x3 LoadPoints(const float* p) {
+#if ENGINE_SIMD_SSE
+		__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);	// x0y0z0x1 y1z1x2y2 z2x3y3z3
+		__m128 x23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+		__m128 y01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), y23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+		__m128 z01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), z23 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+		return {_mm_shuffle_ps(a, x23, _MM_SHUFFLE(3, 0, 3, 0)), _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0))};
+#else
+		Vector4x3 r;
+		for (int i = 0; i < 4; ++i) for (int axis = 0; axis < 3; ++axis) r[axis].v[i] = p[i * 3 + axis];
+		return r;
+#endif
+	}
+
+	void StorePoints(float* p) const {
+#if ENGINE_SIMD_SSE
+		__m128 xy01 = _mm_unpacklo_ps(x.v, y.v), xy23 = _mm_unpackhi_ps(x.v, y.v);	// x0y0x1y1 x2y2x3y3
+		__m128 z0x1 = _mm_shuffle_ps(z.v, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+		__m128 y1z1 = _mm_shuffle_ps(xy01, z.v, _MM_SHUFFLE(1, 1, 3, 3));
+		__m128 z2x3 = _mm_shuffle_ps(z.v, xy23, _MM_SHUFFLE(2, 2, 2, 2)), y3z3 = _mm_shuffle_ps(xy23, z.v, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(p, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(p + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+		_mm_storeu_ps(p + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+#else
+		for (int i = 0; i < 4; ++i) for (int axis = 0; axis < 3; ++axis) p[i * 3 + axis] = (*this)[axis].v[i];
+#endif
+	}
+};
+
+// Kernels over arrays of points, four at a time through Vector4x3 and the last few one by one
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "The kernels read glm::vec3 arrays as packed floats");
+
+// out[i] is points[i] through an affine matrix, out may be points
+inline void TransformPoints(const glm::mat4& matrix, const glm::vec3* points, size_t count, glm::vec3* out) {
+	Float4 m[4][3];
+	for (int column = 0; column < 4; ++column)
+		for (int row = 0; row < 3; ++row) m[column][row] = Float4(matrix[column][row]);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4){
+		Vector4x3 p = Vector4x3::LoadPoints(&points[i].x), t;
+		for (int row = 0; row < 3; ++row) t[row] = m[0][row] * p.x + m[1][row] * p.y + m[2][row] * p.z + m[3][row];
+		t.StorePoints(&out[i].x);
+	}
+	for (; i < count; ++i) out[i] = glm::vec3(matrix * glm::vec4(points[i], 1.0f));
+}
+
+// out[i] = dot(a[i], b[i])
+inline void DotProducts(const glm::vec3* a, const glm::vec3* b, size_t count, float* out) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) Vector4x3::Dot(Vector4x3::LoadPoints(&a[i].x), Vector4x3::LoadPoints(&b[i].x)).Store(out + i);
+	for (; i < count; ++i) out[i] = glm::dot(a[i], b[i]);
+}
+
+// Grows min and max to take in the points
+inline void GrowBounds(const glm::vec3* points, size_t count, glm::vec3& min, glm::vec3& max) {
+	size_t i = 0;
+	if (count >= 4){
+		Vector4x3 low{Float4(min.x), Float4(min.y), Float4(min.z)}, high{Float4(max.x), Float4(max.y), Float4(max.z)};
+		for (; i + 4 <= count; i += 4){
+			Vector4x3 p = Vector4x3::LoadPoints(&points[i].x);
+			for (int axis = 0; axis < 3; ++axis){
+				low[axis] = Float4::Min(p[axis], low[axis]);
+				high[axis] = Float4::Max(p[axis], high[axis]);
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis){
+			float lows[4], highs[4];
+			low[axis].Store(lows);
+			high[axis].Store(highs);
+			min[axis] = std::min(std::min(lows[0], lows[1]), std::min(lows[2], lows[3]));
+			max[axis] = std::max(std::max(highs[0], highs[1]), std::max(highs[2], highs[3]));
+		}
+	}
+	for (; i < count; ++i){
+		min = glm::min(min, points[i]);
+		max = glm::max(max, points[i]);
+	}
+}
+
+} // namespace
+#endif
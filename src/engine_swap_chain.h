@@ -123,6 +123,7 @@ public:
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
+        std::lock_guard<std::mutex> lock(device.queueMutex());
         vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
         if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=VK_SUCCESS) {
             throw std::runtime_error("failed to submit draw command buffer!");
@@ -0,0 +1,43 @@
+#ifndef ENGINE_TIMESTEP_H
+#define ENGINE_TIMESTEP_H
+
+#include <algorithm>
+
+namespace Engine{
+
+// Splits the time between frames into simulation ticks of one fixed length. Whatever is left over
+// carries into the next frame and Alpha says how far the renderer is between the last two ticks.
+// A slow frame runs at most maxTicksPerFrame ticks and drops the rest, so a simulation that cannot
+// keep up slows down instead of stalling while it falls further behind.
+class FixedTimestep{
+public:
+
+	explicit FixedTimestep(float tickRate = 60.0f, int _maxTicksPerFrame = 5)
+		: tickTime{1.0 / tickRate}, maxTicksPerFrame{_maxTicksPerFrame} {}
+
+	float TickTime() const {return static_cast<float>(tickTime);}
+
+	// Adds the frame's time and returns how many ticks to run now
+	int Advance(float frameTime) {
+		accumulator += std::max(frameTime, 0.0f);
+		int ticks = static_cast<int>(accumulator / tickTime);
+		if (ticks > maxTicksPerFrame){
+			ticks = maxTicksPerFrame;
+			accumulator = ticks * tickTime;
+		}
+		accumulator -= ticks * tickTime;
+		return ticks;
+	}
+
+	// Fraction of a tick since the last one, to blend from the state before that tick (0) to the
+	// state after it (1)
+	float Alpha() const {return static_cast<float>(std::min(accumulator / tickTime, 1.0));}
+
+private:
+	double tickTime;
+	int maxTicksPerFrame;
+	double accumulator = 0.0;	// doubles so the leftover doesn't drift over a long session
+};
+
+} // namespace
+#endif
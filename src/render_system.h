@@ -11,7 +11,7 @@
 #include "engine_game_object.h"
 #include "camera.h"
 #include "engine_frame_info.h"
-#include "terrain.h"
+#include "engine_render_snapshot.h"
 
 
 #include <memory>
@@ -43,7 +43,7 @@ public:
 	RenderSystem &operator=(const RenderSystem &) = delete;	
 
 
-	void renderGameObjects(FrameInfo &frameInfo, std::vector<EngineGameObject>& gameObjects, Terrain& terrain)
+	void renderGameObjects(FrameInfo &frameInfo, const std::vector<RenderSnapshot::Object>& objects)
 	{
 		graphicsPipeline->bind(frameInfo.commandBuffer);
 
@@ -57,12 +57,12 @@ public:
 			0, 
 			nullptr);
 
-		// Render game objects
-		for (auto& obj : gameObjects){
+		// Render game objects, matrices come interpolated from the snapshot
+		for (auto& obj : objects){
 
 			SimplePushConstantData push{};
-			push.meshMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
+			push.meshMatrix = obj.meshMatrix;
+			push.normalMatrix = obj.normalMatrix;
 
 			vkCmdPushConstants(
 				frameInfo.commandBuffer, 
@@ -71,26 +71,8 @@ public:
 				0, 
 				sizeof(SimplePushConstantData), 
 				&push);
-			obj.mesh->bind(frameInfo.commandBuffer);
-			obj.mesh->draw(frameInfo.commandBuffer);
-		}
-
-		// Render terrain
-		for (auto& obj : terrain.chunkObjects){
-
-			SimplePushConstantData push{};
-			push.meshMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer, 
-				pipelineLayout, 
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 
-				0, 
-				sizeof(SimplePushConstantData), 
-				&push);
-			obj.mesh->bind(frameInfo.commandBuffer);
-			obj.mesh->draw(frameInfo.commandBuffer);
+			obj.model->bind(frameInfo.commandBuffer);
+			obj.model->draw(frameInfo.commandBuffer);
 		}
 	}
 
@@ -12,6 +12,9 @@
 #include <stdexcept>
 #include <array>
 #include <cassert>
+#include <thread>
+#include <chrono>
+#include <mutex>
 
 namespace Engine{
 class Renderer{
@@ -162,12 +165,16 @@ private:
 
 	void recreateSwapChain(){
 		auto extent = window.getExtent();
+		// Minimised, events are polled by the main thread
 		while (extent.width == 0 || extent.height == 0){
 			extent = window.getExtent();
-			glfwWaitEvents();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		}
 
-		vkDeviceWaitIdle(engineDevice.device());
+		{
+			std::lock_guard<std::mutex> lock(engineDevice.queueMutex());
+			vkDeviceWaitIdle(engineDevice.device());
+		}
 
 		if (engineSwapChain == nullptr){
 			engineSwapChain = std::make_unique<EngineSwapChain>(engineDevice, extent);
@@ -0,0 +1,338 @@
+#ifndef TERRAIN_MODEL_H
+#define TERRAIN_MODEL_H
+
+#include "engine_device.h"
+#include "engine_game_object.h"
+#include "engine_bvh.h"
+#include "../terrain/marching_cubes.h"
+#include "../terrain/horizon.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "../vendor/glm/gtc/packing.hpp"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+namespace Engine{
+
+// Snapshots are numbered as the simulation thread builds them. The render thread retires a number
+// once the GPU is done with every frame drawn from that snapshot or an older one, and never goes back.
+class SnapshotSerials{
+public:
+	static uint64_t Next() {return ++built;}
+	static uint64_t Retired() {return retired.load(std::memory_order_acquire);}
+	static void Retire(uint64_t serial) {if (serial > Retired()) retired.store(serial, std::memory_order_release);}
+
+private:
+	static uint64_t built;	// simulation thread only
+	static std::atomic<uint64_t> retired;
+};
+uint64_t SnapshotSerials::built = 0;
+std::atomic<uint64_t> SnapshotSerials::retired{0};
+
+// Vertex buffer of a terrain chunk or the horizon in a compact 12 byte format.
+// Positions are 16 bit fixed point over the model's extent, measured from the model origin,
+// normals are octahedral in two bytes. The vertex shader scales positions back by the
+// extent, which TerrainRenderSystem pushes with each draw, and picks the material.
+// The baked ambient occlusion and the chunk's light ride in the spare bytes. The horizon has
+// neither, its vertices keep their clipmap level in the material byte and the height they morph
+// to in the light and padding bytes, read together as one unorm16 over the extent.
+// A TriangleBvh over the same quantised positions answers ray queries on the CPU, and a copy
+// of the buffer stays on the CPU so nothing is ever read back from the device.
+// Frames draw the buffer current when their snapshot was built, see drawBuffer. Writes go into it
+// in place unless a frame not yet retired draws it, then into a second buffer no frame draws,
+// which becomes current. Models written while in view so keep two, rarely more.
+class TerrainModel{
+public:
+
+	struct Vertex{
+		uint16_t position[3];	// unorm over the extent
+		uint16_t normal;	// octahedral, two snorm8
+		uint8_t material;	// TerrainMaterial, the level on the horizon
+		uint8_t occlusion;	// unorm, 0 open
+		uint8_t light;	// sky << 4 | block, with padding the morph height on the horizon
+		uint8_t padding;
+
+		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(){
+			std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+			bindingDescriptions[0].binding = 0;
+			bindingDescriptions[0].stride = sizeof(Vertex);
+			bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			return bindingDescriptions;
+		}
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(){
+			// Position is read as 4 components, a format every device fetches, its w overlaps the normal and is ignored
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions(6);
+			attributeDescriptions[0].binding = 0;
+			attributeDescriptions[0].location = 0;
+			attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+			attributeDescriptions[0].offset = offsetof(Vertex, position);
+
+			attributeDescriptions[1].binding = 0;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = VK_FORMAT_R8G8_SNORM;
+			attributeDescriptions[1].offset = offsetof(Vertex, normal);
+
+			attributeDescriptions[2].binding = 0;
+			attributeDescriptions[2].location = 2;
+			attributeDescriptions[2].format = VK_FORMAT_R8_UINT;
+			attributeDescriptions[2].offset = offsetof(Vertex, material);
+
+			attributeDescriptions[3].binding = 0;
+			attributeDescriptions[3].location = 3;
+			attributeDescriptions[3].format = VK_FORMAT_R8_UNORM;
+			attributeDescriptions[3].offset = offsetof(Vertex, occlusion);
+
+			attributeDescriptions[4].binding = 0;
+			attributeDescriptions[4].location = 4;
+			attributeDescriptions[4].format = VK_FORMAT_R8_UINT;
+			attributeDescriptions[4].offset = offsetof(Vertex, light);
+
+			// Overlaps light, only read on the horizon
+			attributeDescriptions[5].binding = 0;
+			attributeDescriptions[5].location = 5;
+			attributeDescriptions[5].format = VK_FORMAT_R16_UNORM;
+			attributeDescriptions[5].offset = offsetof(Vertex, light);
+			return attributeDescriptions;
+		}
+	};
+	static_assert(sizeof(Vertex) == 12, "TerrainModel::Vertex must stay 12 bytes");
+	static_assert(offsetof(Vertex, padding) == offsetof(Vertex, light) + 1, "The morph height spans light and padding");
+
+	// Every position has to lie in [0, extent]
+	TerrainModel(EngineDevice& _engineDevice, const std::vector<TerrainVertex>& vertices, const glm::vec3& _extent) : engineDevice{_engineDevice}, extent{_extent} {
+		std::vector<Vertex> quantised = Quantise(vertices, extent);
+		createVertexBuffers(quantised);
+		bvh = std::make_shared<TriangleBvh>(Positions(quantised, extent));
+	}
+
+	// The horizon, each vertex morphs towards its target in the vertex shader
+	TerrainModel(EngineDevice& _engineDevice, const std::vector<TerrainVertex>& vertices, const std::vector<HorizonClipmap::MorphTarget>& morphTargets, const glm::vec3& _extent) : engineDevice{_engineDevice}, extent{_extent}, morphing{true} {
+		assert(morphTargets.size() == vertices.size() && "One morph target per vertex");
+		std::vector<Vertex> quantised = Quantise(vertices, extent);
+		float scale = 65535.0f / std::max(extent.y, 1e-6f);
+		for (size_t i = 0; i < quantised.size(); ++i){
+			uint16_t height = static_cast<uint16_t>(std::round(glm::clamp(morphTargets[i].height * scale, 0.0f, 65535.0f)));
+			quantised[i].material = morphTargets[i].level;
+			std::memcpy(&quantised[i].light, &height, sizeof(height));
+		}
+		createVertexBuffers(quantised);
+		bvh = std::make_shared<TriangleBvh>(Positions(quantised, extent));
+	}
+
+	~TerrainModel(){
+		for (DeviceBuffer& buffer : buffers){
+			vkDestroyBuffer(engineDevice.device(), buffer.buffer, nullptr);
+			vkFreeMemory(engineDevice.device(), buffer.memory, nullptr);
+		}
+	}
+
+	TerrainModel(const TerrainModel &) = delete;
+	TerrainModel &operator=(const TerrainModel &) = delete;
+
+	// The buffer frames built from snapshot serial draw, not written again until the serial retires.
+	// Simulation thread, the render thread only sees the handle in the snapshot.
+	VkBuffer drawBuffer(uint64_t serial){
+		buffers[current].drawnBy = serial;
+		return buffers[current].buffer;
+	}
+
+	// buffer is one drawBuffer returned
+	void bind(VkCommandBuffer commandBuffer, VkBuffer buffer){
+		VkBuffer bound[] = {buffer};
+		VkDeviceSize offsets[] = {0};
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, bound, offsets);
+	}
+
+	void draw(VkCommandBuffer commandBuffer){
+		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+	}
+
+	uint32_t getVertexCount() const {return vertexCount;}
+	const glm::vec3& getExtent() const {return extent;}
+	const TriangleBvh& getBvh() const {return *bvh;}
+	size_t getBufferCount() const {return buffers.size();}
+
+	// The tree on its own, for the physics scene to keep without holding the buffers. Writes
+	// refit it in place.
+	std::shared_ptr<const TriangleBvh> shareBvh() const {return bvh;}
+	bool isMorphing() const {return morphing;}
+
+	// Overwrites vertices in place from firstVertex on, the buffer is host visible and coherent
+	void writeVertices(uint32_t firstVertex, const std::vector<TerrainVertex> &vertices){
+		if (vertices.empty()) return;
+		assert(firstVertex + vertices.size() <= vertexCount && "Vertex range out of bounds");
+		std::vector<Vertex> quantised = Quantise(vertices, extent);
+		std::copy(quantised.begin(), quantised.end(), shadow.begin() + firstVertex);
+		upload(firstVertex, static_cast<uint32_t>(quantised.size()));
+		bvh->Update(firstVertex, Positions(quantised, extent));
+	}
+
+	// Overwrites only the light of vertices from firstVertex on, the positions and the tree stay
+	void writeLight(uint32_t firstVertex, const std::vector<TerrainVertex> &vertices){
+		if (vertices.empty()) return;
+		assert(firstVertex + vertices.size() <= vertexCount && "Vertex range out of bounds");
+		for (size_t i = 0; i < vertices.size(); ++i) shadow[firstVertex + i].light = vertices[i].light;
+		upload(firstVertex, static_cast<uint32_t>(vertices.size()));
+	}
+
+	// Quantising what this returns again gives back the same vertices
+	std::vector<TerrainVertex> readVertices() const {return Dequantise(shadow, extent);}
+
+	std::vector<TerrainVertex> readVertices(uint32_t firstVertex, uint32_t count) const {
+		assert(firstVertex + count <= vertexCount && "Vertex range out of bounds");
+		return Dequantise(std::vector<Vertex>(shadow.begin() + firstVertex, shadow.begin() + firstVertex + count), extent);
+	}
+
+	static std::vector<Vertex> Quantise(const std::vector<TerrainVertex>& vertices, const glm::vec3& extent) {
+		std::vector<Vertex> quantised(vertices.size());
+		glm::vec3 scale = 65535.0f / glm::max(extent, glm::vec3(1e-6f));
+		for (size_t i = 0; i < vertices.size(); ++i){
+			glm::vec3 position = glm::round(glm::clamp(vertices[i].position * scale, 0.0f, 65535.0f));
+			Vertex& vertex = quantised[i];
+			vertex.position[0] = static_cast<uint16_t>(position.x);
+			vertex.position[1] = static_cast<uint16_t>(position.y);
+			vertex.position[2] = static_cast<uint16_t>(position.z);
+
+			// Requantised in the encoded square, not through a unit vector
+			vertex.normal = glm::packSnorm2x8(glm::unpackSnorm2x16(vertices[i].normal));
+			vertex.material = static_cast<uint8_t>(vertices[i].material);
+			vertex.occlusion = vertices[i].occlusion;
+			vertex.light = vertices[i].light;
+		}
+		return quantised;
+	}
+
+	static std::vector<TerrainVertex> Dequantise(const std::vector<Vertex>& quantised, const glm::vec3& extent) {
+		std::vector<TerrainVertex> vertices(quantised.size());
+		glm::vec3 scale = extent / 65535.0f;
+		for (size_t i = 0; i < quantised.size(); ++i){
+			const Vertex& vertex = quantised[i];
+			vertices[i].position = glm::vec3{vertex.position[0], vertex.position[1], vertex.position[2]} * scale;
+			vertices[i].normal = glm::packSnorm2x16(glm::unpackSnorm2x8(vertex.normal));
+			vertices[i].material = static_cast<TerrainMaterial>(vertex.material);
+			vertices[i].occlusion = vertex.occlusion;
+			vertices[i].light = vertex.light;
+		}
+		return vertices;
+	}
+
+private:
+
+	// What the tree is built and refitted over, scaled back by the extent four points at a time
+	static std::vector<glm::vec3> Positions(const std::vector<Vertex>& quantised, const glm::vec3& extent) {
+		std::vector<glm::vec3> positions(quantised.size());
+		for (size_t i = 0; i < quantised.size(); ++i) positions[i] = glm::vec3{quantised[i].position[0], quantised[i].position[1], quantised[i].position[2]};
+		glm::vec3 scale = extent / 65535.0f;
+		glm::mat4 dequantise{glm::vec4{scale.x, 0.0f, 0.0f, 0.0f}, glm::vec4{0.0f, scale.y, 0.0f, 0.0f}, glm::vec4{0.0f, 0.0f, scale.z, 0.0f}, glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+		TransformPoints(dequantise, positions.data(), positions.size(), positions.data());
+		return positions;
+	}
+
+	// A copy of the vertices on the device
+	struct DeviceBuffer{
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		uint64_t drawnBy = 0;	// serial of the last snapshot drawing it
+		uint32_t staleFirst = 0;	// vertices written since into the other buffers
+		uint32_t staleEnd = 0;
+	};
+
+	void createVertexBuffers(const std::vector<Vertex> &vertices){
+		vertexCount = static_cast<uint32_t>(vertices.size());
+		assert(vertexCount >= 3 && "Vertex cout must be at least 3");
+		shadow = vertices;
+		buffers.push_back(createBuffer());
+		upload(0, vertexCount);
+	}
+
+	// Out of date throughout, the first write brings it up to date
+	DeviceBuffer createBuffer(){
+		DeviceBuffer buffer;
+		engineDevice.createBuffer(
+			sizeof(Vertex) * vertexCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer.buffer,
+			buffer.memory);
+		buffer.staleEnd = vertexCount;
+		return buffer;
+	}
+
+	// Copies a range of the CPU copy into a buffer no frame in flight draws, which becomes current
+	void upload(uint32_t firstVertex, uint32_t count){
+		uint64_t retired = SnapshotSerials::Retired();
+		if (buffers[current].drawnBy > retired){
+			current = 0;
+			while (current < buffers.size() && buffers[current].drawnBy > retired) ++current;
+			if (current == buffers.size()) buffers.push_back(createBuffer());
+		}
+
+		// Along with whatever it missed while the others were written
+		DeviceBuffer& buffer = buffers[current];
+		MarkStale(buffer, firstVertex, count);
+		copy(buffer, buffer.staleFirst, buffer.staleEnd - buffer.staleFirst);
+		buffer.staleFirst = buffer.staleEnd = 0;
+		for (DeviceBuffer& other : buffers){
+			if (&other != &buffer) MarkStale(other, firstVertex, count);
+		}
+	}
+
+	// One span covers every range written since, empty when staleFirst is not below staleEnd
+	static void MarkStale(DeviceBuffer& buffer, uint32_t firstVertex, uint32_t count){
+		buffer.staleFirst = buffer.staleFirst < buffer.staleEnd ? std::min(buffer.staleFirst, firstVertex) : firstVertex;
+		buffer.staleEnd = std::max(buffer.staleEnd, firstVertex + count);
+	}
+
+	void copy(const DeviceBuffer& buffer, uint32_t firstVertex, uint32_t count){
+		VkDeviceSize offset = sizeof(Vertex) * firstVertex;
+		VkDeviceSize size = sizeof(Vertex) * count;
+
+		void *data;
+		vkMapMemory(engineDevice.device(), buffer.memory, offset, size, 0, &data);
+		memcpy(data, shadow.data() + firstVertex, static_cast<size_t>(size));
+		vkUnmapMemory(engineDevice.device(), buffer.memory);
+	}
+
+	EngineDevice& engineDevice;
+	glm::vec3 extent;
+	std::vector<DeviceBuffer> buffers;
+	size_t current = 0;	// the one the next snapshot draws
+	uint32_t vertexCount;
+	bool morphing = false;
+	std::vector<Vertex> shadow;	// what the current buffer holds
+	std::shared_ptr<TriangleBvh> bvh;
+};
+
+// A chunk or the horizon, the transform places the model origin in the world
+// Chunks are placed once, the matrix is worked out when the transform is set rather than per draw
+struct TerrainObject{
+	std::shared_ptr<TerrainModel> model{};
+
+	const TransformComponent& getTransform() const {return transform;}
+	const glm::mat4& getMatrix() const {return matrix;}
+
+	void setTransform(const TransformComponent& _transform) {
+		transform = _transform;
+		matrix = transform.mat4();
+	}
+
+	void setTranslation(const glm::vec3& translation) {
+		transform.translation = translation;
+		matrix = transform.mat4();
+	}
+
+private:
+	TransformComponent transform;
+	glm::mat4 matrix{1.0f};
+};
+
+} // namespace
+#endif
@@ -11,6 +11,11 @@
 #include "engine_game_object.h"
 #include "camera.h"
 #include "engine_frame_info.h"
+#include "engine_buffer.h"
+#include "engine_descriptor.h"
+#include "engine_swap_chain.h"
+#include "terrain_model.h"
+#include "engine_render_snapshot.h"
 #include "../terrain/terrain.h"
 
 
@@ -22,11 +27,40 @@
 
 namespace Engine{
 
+struct TerrainPushConstantData{
+	glm::mat4 meshMatrix{1.0f};
+	glm::vec4 positionScale{1.0f};	// xyz, the model's extent its unorm positions scale to
+	glm::vec4 morph{0.0f};	// xy the camera's xz from the model origin, zw where level 0 starts and ends morphing, 0 for no morph
+};
+
+// Material rules the terrain fragment shader evaluates, std140 layout
+struct TerrainMaterialUbo{
+	glm::vec4 stoneColour{};
+	glm::vec4 grassColour{};
+	glm::vec4 snowColour{};
+	float snowMinHeight = 0.0f;	// world units
+	float snowMinNormalY = 0.0f;	// cos of snowMaxAngle
+	float grassMinNormalY = 0.0f;	// cos of grassMaxAngle
+	float padding = 0.0f;
+
+	static TerrainMaterialUbo FromSettings(const TerrainSettings& settings) {
+		TerrainMaterialUbo ubo{};
+		ubo.stoneColour = glm::vec4(settings.stoneColour, 1.0f);
+		ubo.grassColour = glm::vec4(settings.grassColour, 1.0f);
+		ubo.snowColour = glm::vec4(settings.snowColour, 1.0f);
+		ubo.snowMinHeight = settings.snowMinHeightPercent * settings.worldHeight;
+		ubo.snowMinNormalY = glm::cos(glm::radians(settings.snowMaxAngle));
+		ubo.grassMinNormalY = glm::cos(glm::radians(settings.grassMaxAngle));
+		return ubo;
+	}
+};
+
 class TerrainRenderSystem{
 public:
 
 	TerrainRenderSystem(EngineDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : engineDevice{device} 
 	{
+		createMaterialDescriptors();
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
 	}
@@ -38,7 +72,7 @@ public:
 	TerrainRenderSystem &operator=(const TerrainRenderSystem &) = delete;	
 
 
-	void renderTerrain(FrameInfo &frameInfo, Terrain& terrain)
+	void renderTerrain(FrameInfo &frameInfo, const RenderSnapshot& snapshot)
 	{
 		graphicsPipeline->bind(frameInfo.commandBuffer);
 
@@ -52,36 +86,97 @@ public:
 			0, 
 			nullptr);
 
-		// Render terrain
-		for (auto& obj : terrain.chunkObjects){
-
-			SimplePushConstantData push{};
-			push.meshMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer, 
-				pipelineLayout, 
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 
-				0, 
-				sizeof(SimplePushConstantData), 
-				&push);
-			obj.mesh->bind(frameInfo.commandBuffer);
-			obj.mesh->draw(frameInfo.commandBuffer);
+		// Rules are read from the settings every frame, changing them needs no re-meshing
+		TerrainMaterialUbo materialUbo = TerrainMaterialUbo::FromSettings(snapshot.terrainSettings);
+		materialBuffers[frameInfo.frameIndex]->writeToBuffer(&materialUbo);
+		materialBuffers[frameInfo.frameIndex]->flush();
+
+		vkCmdBindDescriptorSets(
+			frameInfo.commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			1, 
+			1, 
+			&materialDescriptorSets[frameInfo.frameIndex],
+			0, 
+			nullptr);
+
+		// Render the chunks in view
+		for (size_t i = 0; i < snapshot.chunks.size(); ++i){
+			renderObject(frameInfo, snapshot.chunks[i], snapshot.chunkBuffers[i]);
+		}
+
+		// Distant heightfield, a single draw, morphing by the camera's distance
+		glm::vec4 morph{0.0f};
+		if (snapshot.horizonRingCells > 0){
+			glm::vec3 camera = snapshot.camera.position - snapshot.horizon.getTransform().translation;
+			float spacing = static_cast<float>(snapshot.terrainSettings.chunkSize);
+			morph = {camera.x, camera.z, HorizonClipmap::MorphStart(snapshot.horizonRingCells) * spacing, HorizonClipmap::MorphEnd(snapshot.horizonRingCells) * spacing};
 		}
+		renderObject(frameInfo, snapshot.horizon, snapshot.horizonBuffer, morph);
 	}
 
 
 private:
 
+	void renderObject(FrameInfo &frameInfo, const TerrainObject& obj, VkBuffer buffer, const glm::vec4& morph = glm::vec4{0.0f}) {
+
+		// Empty chunks have no model
+		if (!obj.model) return;
+
+		TerrainPushConstantData push{};
+		push.meshMatrix = obj.getMatrix();
+		push.positionScale = glm::vec4(obj.model->getExtent(), 0.0f);
+		if (obj.model->isMorphing()) push.morph = morph;
+
+		vkCmdPushConstants(
+			frameInfo.commandBuffer, 
+			pipelineLayout, 
+			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 
+			0, 
+			sizeof(TerrainPushConstantData), 
+			&push);
+		obj.model->bind(frameInfo.commandBuffer, buffer);
+		obj.model->draw(frameInfo.commandBuffer);
+	}
+
+	// Set 1, one material buffer per frame in flight
+	void createMaterialDescriptors() {
+		materialPool = EngineDescriptorPool::Builder(engineDevice)
+		.setMaxSets(EngineSwapChain::MAX_FRAMES_IN_FLIGHT)
+		.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, EngineSwapChain::MAX_FRAMES_IN_FLIGHT)
+		.build();
+
+		materialSetLayout = EngineDescriptorSetLayout::Builder(engineDevice)
+		.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		.build();
+
+		materialBuffers.resize(EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+		materialDescriptorSets.resize(EngineSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (int i = 0; i < EngineSwapChain::MAX_FRAMES_IN_FLIGHT; ++i){
+			materialBuffers[i] = std::make_unique<EngineBuffer>(
+				engineDevice,
+				sizeof(TerrainMaterialUbo),
+				1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			materialBuffers[i]->map();
+
+			auto bufferInfo = materialBuffers[i]->descriptorInfo();
+			EngineDescriptorWriter(*materialSetLayout, *materialPool)
+			.writeBuffer(0, &bufferInfo)
+			.build(materialDescriptorSets[i]);
+		}
+	}
+
 	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
 
 		VkPushConstantRange pushConstantRange{};
 		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
+		pushConstantRange.size = sizeof(TerrainPushConstantData);
 
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout, materialSetLayout->getDescriptorSetLayout()};
 
 
 
@@ -103,10 +198,12 @@ private:
 		GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = renderPass;	
 		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipelineConfig.bindingDescriptions = TerrainModel::Vertex::getBindingDescriptions();
+		pipelineConfig.attributeDescriptions = TerrainModel::Vertex::getAttributeDescriptions();
 		graphicsPipeline = std::make_unique<GraphicsPipeline>(
 			engineDevice, 
-			"shaders/shader.vert.spv", 
-			"shaders/shader.frag.spv", 
+			"shaders/terrain.vert.spv", 
+			"shaders/terrain.frag.spv", 
 			pipelineConfig);
 	}
 
@@ -114,6 +211,11 @@ private:
     EngineDevice& engineDevice;
     std::unique_ptr<GraphicsPipeline> graphicsPipeline;
     VkPipelineLayout pipelineLayout;
+
+    std::unique_ptr<EngineDescriptorPool> materialPool;
+    std::unique_ptr<EngineDescriptorSetLayout> materialSetLayout;
+    std::vector<std::unique_ptr<EngineBuffer>> materialBuffers;
+    std::vector<VkDescriptorSet> materialDescriptorSets;
 };
 
 
@@ -0,0 +1,108 @@
+#ifndef AMBIENT_OCCLUSION_H
+#define AMBIENT_OCCLUSION_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "chunk_density.h"
+#include "marching_cubes.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+// Ambient occlusion baked from the density lattice a chunk was meshed from.
+// A corner's openness is the share of air corners in a box around it, every box is summed in
+// constant time from a summed volume table of the lattice. Flat ground sees half air and is
+// left unoccluded, crevices and caves see less and darken.
+//
+// Boxes narrow towards the chunk's side faces, a corner on a face only looks up and down its
+// own column, so both chunks sharing a face bake the same values from the corners they share.
+class LatticeOcclusion{
+public:
+
+	// chunkCells is the chunk's width in cells, the lattice may carry padding past it
+	LatticeOcclusion(const ChunkDensity& density, float isoLevel, int chunkCells, int _radius)
+	: size{density.sizeX, density.sizeY, density.sizeZ}, radius{std::max(_radius, 0)} {
+		if (radius == 0) return;
+		openness.resize(density.count());
+
+		// table(x, y, z) counts the air corners with every coordinate below (x, y, z)
+		glm::ivec3 tableSize = size + 1;
+		std::vector<int> table(static_cast<size_t>(tableSize.x) * tableSize.y * tableSize.z, 0);
+		auto at = [&](int x, int y, int z) -> int& {return table[(static_cast<size_t>(x) * tableSize.y + y) * tableSize.z + z];};
+		for (int x = 1; x <= size.x; ++x)
+			for (int y = 1; y <= size.y; ++y)
+				for (int z = 1; z <= size.z; ++z)
+					at(x, y, z) = (density.get(x - 1, y - 1, z - 1) < isoLevel ? 1 : 0)
+						+ at(x - 1, y, z) + at(x, y - 1, z) + at(x, y, z - 1)
+						- at(x - 1, y - 1, z) - at(x - 1, y, z - 1) - at(x, y - 1, z - 1)
+						+ at(x - 1, y - 1, z - 1);
+
+		for (int x = 0; x < size.x; ++x){
+			for (int y = 0; y < size.y; ++y){
+				for (int z = 0; z < size.z; ++z){
+					glm::ivec3 corner{x, y, z};
+					glm::ivec3 half{SideHalfWidth(x, chunkCells), radius, SideHalfWidth(z, chunkCells)};
+					glm::ivec3 low = glm::max(corner - half, glm::ivec3(0));
+					glm::ivec3 high = glm::min(corner + half, size - 1) + 1;
+					int air = at(high.x, high.y, high.z)
+						- at(low.x, high.y, high.z) - at(high.x, low.y, high.z) - at(high.x, high.y, low.z)
+						+ at(low.x, low.y, high.z) + at(low.x, high.y, low.z) + at(high.x, low.y, low.z)
+						- at(low.x, low.y, low.z);
+					glm::ivec3 extent = high - low;
+					openness[density.index(x, y, z)] = static_cast<float>(air) / (extent.x * extent.y * extent.z);
+				}
+			}
+		}
+	}
+
+	// Occlusion at a mesh position, in lattice units, trilinear between the corners around it.
+	// 0 is open, 255 fully enclosed.
+	uint8_t At(const glm::vec3& position) const {
+		glm::vec3 p = glm::clamp(position, glm::vec3(0.0f), glm::vec3(size - 1));
+		glm::ivec3 low = glm::min(glm::ivec3(glm::floor(p)), glm::max(size - 2, glm::ivec3(0)));
+		glm::vec3 t = glm::min(p - glm::vec3(low), glm::vec3(1.0f));
+		float value = 0.0f;
+		for (int i = 0; i < 8; ++i){
+			glm::ivec3 offset{i & 1, (i >> 1) & 1, (i >> 2) & 1};
+			glm::ivec3 corner = glm::min(low + offset, size - 1);
+			glm::vec3 weight = glm::mix(1.0f - t, t, glm::vec3(offset));
+			value += Openness(corner) * weight.x * weight.y * weight.z;
+		}
+		return Occlusion(value);
+	}
+
+	// Bakes vertices from first on, positions are step units per cell
+	void Apply(std::vector<TerrainVertex>& vertices, float step, size_t first = 0) const {
+		if (radius == 0) return;
+		for (size_t i = first; i < vertices.size(); ++i) vertices[i].occlusion = At(vertices[i].position / step);
+	}
+
+	bool enabled() const {return radius > 0;}
+
+private:
+	glm::ivec3 size;
+	int radius;
+	std::vector<float> openness;
+
+	float Openness(const glm::ivec3& corner) const {
+		return openness[(static_cast<size_t>(corner.x) * size.y + corner.y) * size.z + corner.z];
+	}
+
+	// Shrinks to 0 on a side face and on the corners next to it, which the padding past +X and +Z holds
+	int SideHalfWidth(int index, int chunkCells) const {
+		int offset = index % chunkCells;
+		int toFace = std::min(offset, chunkCells - offset);
+		return glm::clamp(toFace - 1, 0, radius);
+	}
+
+	// Half air is open ground, all solid fully enclosed
+	static uint8_t Occlusion(float openness) {
+		return static_cast<uint8_t>(glm::clamp(1.0f - 2.0f * openness, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+};
+
+} // namespace
+#endif
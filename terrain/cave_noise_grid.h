@@ -0,0 +1,86 @@
+#ifndef CAVE_NOISE_GRID_H
+#define CAVE_NOISE_GRID_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace Engine{
+
+// Cave noise sampled every decimation corners and trilinearly upsampled to the lattice.
+// Coarse points are only evaluated the first time an interpolation needs them,
+// so blocks skipped by the noise bounds cost nothing here either.
+// Coarse points sit on multiples of decimation, so grids over neighbouring
+// blocks in the same coordinates agree on their shared faces.
+class CaveNoiseGrid{
+public:
+
+	// Covers the inclusive lattice block [min, max]
+	void Reset(glm::ivec3 _min, glm::ivec3 _max, int _decimation) {
+		decimation = std::max(1, _decimation);
+		min = FloorToMultiple(_min);
+		glm::ivec3 extent = _max - min;
+		size = extent / decimation + 1;
+		size += glm::ivec3(extent.x % decimation != 0, extent.y % decimation != 0, extent.z % decimation != 0);
+		values.assign(static_cast<size_t>(size.x) * size.y * size.z, std::numeric_limits<float>::quiet_NaN());
+		evaluated = 0;
+	}
+
+	// sampleNoise(latticeX, latticeY, latticeZ) evaluates the full resolution noise at a lattice corner
+	template<typename Sampler>
+	float Sample(int x, int y, int z, Sampler&& sampleNoise) {
+		glm::ivec3 relative = glm::ivec3(x, y, z) - min;
+		glm::ivec3 cell = relative / decimation;
+		glm::vec3 t = glm::vec3(relative - cell * decimation) / static_cast<float>(decimation);
+
+		float result = 0.0f;
+		for (int corner = 0; corner < 8; ++corner){
+			int dx = corner & 1, dy = (corner >> 1) & 1, dz = (corner >> 2) & 1;
+			float weight = (dx ? t.x : 1.0f - t.x) * (dy ? t.y : 1.0f - t.y) * (dz ? t.z : 1.0f - t.z);
+			if (weight == 0.0f) continue;
+			result += weight * Coarse(cell.x + dx, cell.y + dy, cell.z + dz, sampleNoise);
+		}
+		return result;
+	}
+
+	// Coarse points evaluated since the last Reset
+	size_t getEvaluatedCount() const {return evaluated;}
+
+	// A trilinear value mixes coarse samples up to this far from the corner
+	static float InterpolationRadius(int decimation) {
+		return decimation > 1 ? decimation * std::sqrt(3.0f) : 0.0f;
+	}
+
+private:
+	glm::ivec3 min{0};
+	glm::ivec3 size{0};
+	int decimation = 1;
+	std::vector<float> values;
+	size_t evaluated = 0;
+
+	glm::ivec3 FloorToMultiple(glm::ivec3 value) const {
+		glm::ivec3 result;
+		for (int i = 0; i < 3; ++i){
+			int remainder = value[i] % decimation;
+			result[i] = value[i] - (remainder < 0 ? remainder + decimation : remainder);
+		}
+		return result;
+	}
+
+	template<typename Sampler>
+	float Coarse(int i, int j, int k, Sampler& sampleNoise) {
+		float& value = values[(static_cast<size_t>(i) * size.y + j) * size.z + k];
+		if (std::isnan(value)){
+			value = sampleNoise(min.x + i * decimation, min.y + j * decimation, min.z + k * decimation);
+			evaluated++;
+		}
+		return value;
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,37 @@
+#ifndef CHUNK_DENSITY_H
+#define CHUNK_DENSITY_H
+
+#include <vector>
+#include <cstddef>
+
+namespace Engine{
+
+// Density values sampled at the cube corners of a chunk.
+// A chunk of N x H x N cubes has (N+1) x (H+1) x (N+1) corners, neighbouring
+// cubes share their corners so each corner is only sampled once.
+// Solid where density > isoLevel.
+struct ChunkDensity{
+	int sizeX = 0;
+	int sizeY = 0;
+	int sizeZ = 0;
+	std::vector<float> values;
+
+	ChunkDensity() = default;
+	ChunkDensity(int _sizeX, int _sizeY, int _sizeZ, float fill = 0.0f)
+	: sizeX(_sizeX), sizeY(_sizeY), sizeZ(_sizeZ), values(static_cast<size_t>(_sizeX) * _sizeY * _sizeZ, fill) {}
+
+	// x-major, then y, then z - matches the GenerateChunk loop order
+	size_t index(int x, int y, int z) const {
+		return (static_cast<size_t>(x) * sizeY + y) * sizeZ + z;
+	}
+
+	float get(int x, int y, int z) const {return values[index(x, y, z)];}
+	void set(int x, int y, int z, float value) {values[index(x, y, z)] = value;}
+
+	bool empty() const {return values.empty();}
+	size_t count() const {return values.size();}
+	size_t memoryBytes() const {return values.size() * sizeof(float);}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,145 @@
+#ifndef CHUNK_MESH_H
+#define CHUNK_MESH_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "marching_cubes.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+// A chunk's vertex buffer split into fixed slots, one per block of cells
+// (blockCells x sectionCells x blockCells). An edit re-meshes only the blocks it
+// touches and rewrites their slots in place, spare slot space holds degenerate
+// triangles. A block that outgrows its slot needs the buffer packed again.
+class ChunkMeshLayout{
+public:
+
+	struct Slot{
+		uint32_t first = 0;
+		uint32_t capacity = 0;
+		uint32_t count = 0;
+	};
+
+	// Cell counts of the chunk, sectionCells matches the chunk's sections
+	void Reset(int cellsX, int cellsY, int cellsZ, int _blockCells, int _sectionCells) {
+		cells = {cellsX, cellsY, cellsZ};
+		blockCells = std::max(1, _blockCells);
+		sectionCells = std::max(1, _sectionCells);
+		blocks = {(cellsX + blockCells - 1) / blockCells, (cellsY + sectionCells - 1) / sectionCells, (cellsZ + blockCells - 1) / blockCells};
+		slots.assign(static_cast<size_t>(blocks.x) * blocks.y * blocks.z, Slot{});
+		totalVertices = 0;
+	}
+
+	int BlockCount() const {return static_cast<int>(slots.size());}
+
+	int BlockOf(glm::ivec3 cell) const {
+		glm::ivec3 block = glm::clamp(glm::ivec3{cell.x / blockCells, cell.y / sectionCells, cell.z / blockCells}, glm::ivec3(0), blocks - 1);
+		return (block.x * blocks.y + block.y) * blocks.z + block.z;
+	}
+
+	// First cell of a block and one past its last
+	glm::ivec3 BlockMin(int block) const {
+		glm::ivec3 index{block / (blocks.y * blocks.z), (block / blocks.z) % blocks.y, block % blocks.z};
+		return index * glm::ivec3{blockCells, sectionCells, blockCells};
+	}
+	glm::ivec3 BlockMax(int block) const {
+		return glm::min(BlockMin(block) + glm::ivec3{blockCells, sectionCells, blockCells}, cells);
+	}
+
+	// Blocks holding any of the cells in [cellMin, cellMax], inclusive
+	std::vector<int> BlocksIn(glm::ivec3 cellMin, glm::ivec3 cellMax) const {
+		std::vector<int> result;
+		glm::ivec3 low = glm::clamp(cellMin, glm::ivec3(0), cells - 1);
+		glm::ivec3 high = glm::clamp(cellMax, glm::ivec3(0), cells - 1);
+		for (int x = low.x / blockCells; x <= high.x / blockCells; ++x)
+			for (int y = low.y / sectionCells; y <= std::min(high.y / sectionCells, blocks.y - 1); ++y)
+				for (int z = low.z / blockCells; z <= high.z / blockCells; ++z)
+					result.push_back((x * blocks.y + y) * blocks.z + z);
+		return result;
+	}
+
+	// Sorts triangles into blocks by the cell owning them, positions are step units per cell.
+	// Marching cubes triangles go by the cell their centroid lies in, dual mesh triangles by the
+	// lowest cell of their vertices, the cell owning the edge they were built around (see
+	// DualMesher), and block faces by the cell below their plane (see GreedyMesher).
+	std::vector<std::vector<TerrainVertex>> Bucket(const std::vector<TerrainVertex>& vertices, float step, TerrainMesher mesher = TerrainMesher::MarchingCubes) const {
+		std::vector<std::vector<TerrainVertex>> result(slots.size());
+		for (size_t i = 0; i + 2 < vertices.size(); i += 3){
+			const glm::vec3& a = vertices[i].position;
+			const glm::vec3& b = vertices[i + 1].position;
+			const glm::vec3& c = vertices[i + 2].position;
+			glm::ivec3 cell;
+			if (mesher == TerrainMesher::MarchingCubes) cell = glm::ivec3(glm::floor((a + b + c) / (3.0f * step)));
+			else cell = glm::ivec3(glm::floor(glm::min(glm::min(a, b), c) / step));
+			if (mesher == TerrainMesher::Blocks){
+				glm::vec3 normal = glm::abs(glm::cross(b - a, c - a));
+				cell[normal.x >= normal.y && normal.x >= normal.z ? 0 : (normal.y >= normal.z ? 1 : 2)]--;
+			}
+			std::vector<TerrainVertex>& block = result[BlockOf(cell)];
+			block.insert(block.end(), vertices.begin() + i, vertices.begin() + i + 3);
+		}
+		return result;
+	}
+
+	// Lays every block out with room to grow and returns the padded buffer contents
+	std::vector<TerrainVertex> Pack(const std::vector<std::vector<TerrainVertex>>& blockVertices) {
+		std::vector<TerrainVertex> packed;
+		uint32_t first = 0;
+		for (size_t b = 0; b < slots.size(); ++b){
+			uint32_t count = static_cast<uint32_t>(blockVertices[b].size());
+			slots[b] = {first, SlotCapacity(count), count};
+			packed.insert(packed.end(), blockVertices[b].begin(), blockVertices[b].end());
+			packed.resize(first + slots[b].capacity, DegenerateVertex());
+			first += slots[b].capacity;
+		}
+		totalVertices = first;
+		return packed;
+	}
+
+	// Splits a packed buffer back into the live vertices of each block
+	std::vector<std::vector<TerrainVertex>> Unpack(const std::vector<TerrainVertex>& packed) const {
+		std::vector<std::vector<TerrainVertex>> result(slots.size());
+		for (size_t b = 0; b < slots.size(); ++b){
+			if (slots[b].first + slots[b].count > packed.size()) continue;
+			result[b].assign(packed.begin() + slots[b].first, packed.begin() + slots[b].first + slots[b].count);
+		}
+		return result;
+	}
+
+	// Pads block vertices to the slot size, false if they do not fit
+	bool FillSlot(int block, std::vector<TerrainVertex>& vertices) {
+		Slot& slot = slots[block];
+		if (vertices.size() > slot.capacity) return false;
+		slot.count = static_cast<uint32_t>(vertices.size());
+		vertices.resize(slot.capacity, DegenerateVertex());
+		return true;
+	}
+
+	const Slot& getSlot(int block) const {return slots[block];}
+	uint32_t getTotalVertices() const {return totalVertices;}
+
+private:
+	// Zero area, the rasteriser drops it
+	static TerrainVertex DegenerateVertex() {return {glm::vec3{0.0f}, 0};}
+
+	glm::ivec3 cells{0};
+	glm::ivec3 blocks{0};
+	int blockCells = 8;
+	int sectionCells = 16;
+	std::vector<Slot> slots;
+	uint32_t totalVertices = 0;
+
+	// A quarter extra, at least 16 triangles, empty blocks get no slot until an edit fills them
+	static uint32_t SlotCapacity(uint32_t count) {
+		if (count == 0) return 0;
+		uint32_t spare = std::max<uint32_t>(48, (count / 4) / 3 * 3);
+		return count + spare;
+	}
+};
+
+} // namespace
+#endif
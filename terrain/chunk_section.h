@@ -0,0 +1,63 @@
+#ifndef CHUNK_SECTION_H
+#define CHUNK_SECTION_H
+
+#include "chunk_density.h"
+#include "compressed_density.h"
+#include <cstdint>
+
+namespace Engine{
+
+enum class SectionState : uint8_t { Air, Solid, Mixed };
+
+// A fixed height slice of a chunk.
+// Air and Solid sections are known from the heightmap alone and hold no density,
+// only Mixed sections are sampled, meshed and stored.
+struct ChunkSection{
+	SectionState state = SectionState::Air;
+	int latticeMinY = 0; // first lattice layer, the top layer is shared with the next section
+	int latticeMaxY = 0; // last lattice layer, inclusive
+	CompressedDensity density;
+
+	int cubeCount() const {return latticeMaxY - latticeMinY;}
+
+	float get(int x, int y, int z) const {
+		switch (state){
+			case SectionState::Air: return CompressedDensity::airValue;
+			case SectionState::Solid: return CompressedDensity::solidValue;
+			default: return density.get(x, y - latticeMinY, z);
+		}
+	}
+
+	// Air or solid if every corner of the section lies on one side of isoLevel
+	static SectionState Classify(const ChunkDensity& lattice, int latticeMinY, int latticeMaxY, float isoLevel) {
+		bool anyAir = false;
+		bool anySolid = false;
+		for (int x = 0; x < lattice.sizeX; ++x){
+			for (int y = latticeMinY; y <= latticeMaxY; ++y){
+				for (int z = 0; z < lattice.sizeZ; ++z){
+					if (lattice.get(x, y, z) < isoLevel) anyAir = true;
+					else anySolid = true;
+					if (anyAir && anySolid) return SectionState::Mixed;
+				}
+			}
+		}
+		return anySolid ? SectionState::Solid : SectionState::Air;
+	}
+
+	// Turns an air or solid section into a mixed one holding its uniform value, so it can be edited
+	void Expand(int sizeX, int sizeZ, float isoLevel, CompressedDensity::Precision precision) {
+		if (state == SectionState::Mixed) return;
+		ChunkDensity slice(sizeX, latticeMaxY - latticeMinY + 1, sizeZ, get(0, latticeMinY, 0));
+		state = SectionState::Mixed;
+		density.Compress(slice, isoLevel, precision);
+	}
+
+	// Compresses the section's layers out of a whole chunk lattice
+	void Store(const ChunkDensity& lattice, float isoLevel, CompressedDensity::Precision precision) {
+		if (state != SectionState::Mixed) {density = CompressedDensity{}; return;}
+		density.Compress(lattice, latticeMinY, latticeMaxY, isoLevel, precision);
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,319 @@
+#ifndef COMPRESSED_DENSITY_H
+#define COMPRESSED_DENSITY_H
+
+#include "chunk_density.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+namespace Engine{
+
+// Resident storage for a chunk's density lattice.
+//
+// Each (x, z) column is a list of runs along y. Corners far from the isosurface
+// only need to be on the right side of isoLevel, so they collapse into air or
+// solid runs. Corners on a crossing edge, and their direct neighbours (needed for
+// gradients), keep their value quantised to 8 or 16 bits as literal runs.
+class CompressedDensity{
+public:
+
+	enum class Precision : uint8_t { Bits8 = 1, Bits16 = 2 };
+
+	static constexpr float airValue = 0.0f;
+	static constexpr float solidValue = 1.0f;
+
+	struct MemoryStats{
+		size_t compressedBytes = 0;
+		size_t uncompressedBytes = 0;
+		size_t runCount = 0;
+		size_t literalCount = 0;
+
+		MemoryStats& operator+=(const MemoryStats& other){
+			compressedBytes += other.compressedBytes;
+			uncompressedBytes += other.uncompressedBytes;
+			runCount += other.runCount;
+			literalCount += other.literalCount;
+			return *this;
+		}
+
+		float ratio() const {return compressedBytes == 0 ? 0.0f : static_cast<float>(uncompressedBytes) / compressedBytes;}
+	};
+
+	CompressedDensity() = default;
+
+	// What a stored literal decodes to, lattices sampled outside a chunk use it to put their crossings where the chunk does
+	static float QuantiseLiteral(float value, float isoLevel, Precision precision) {
+		return LiteralSteps(value, isoLevel, precision) / Steps(precision);
+	}
+
+	void Compress(const ChunkDensity& density, float isoLevel, Precision _precision = Precision::Bits16) {
+		Compress(density, 0, density.sizeY - 1, isoLevel, _precision);
+	}
+
+	// Compresses layers [minY, maxY] of a taller lattice. The surface band also looks one layer
+	// past either end, so a layer shared with the next slice keeps the literals that slice's
+	// crossings need whichever of the two it is read from.
+	void Compress(const ChunkDensity& lattice, int minY, int maxY, float isoLevel, Precision _precision = Precision::Bits16) {
+		int low = std::max(minY - 1, 0);
+		int high = std::min(maxY + 1, lattice.sizeY - 1);
+		ChunkDensity density(lattice.sizeX, high - low + 1, lattice.sizeZ);
+		for (int x = 0; x < lattice.sizeX; ++x)
+			for (int y = low; y <= high; ++y)
+				for (int z = 0; z < lattice.sizeZ; ++z)
+					density.set(x, y - low, z, lattice.get(x, y, z));
+
+		sizeX = lattice.sizeX;
+		sizeY = maxY - minY + 1;
+		sizeZ = lattice.sizeZ;
+		precision = _precision;
+		runs.clear();
+		literals.clear();
+		columnRunStart.assign(static_cast<size_t>(sizeX) * sizeZ + 1, 0);
+		columnLiteralStart.assign(static_cast<size_t>(sizeX) * sizeZ + 1, 0);
+
+		std::vector<uint8_t> keep = SurfaceBand(density, isoLevel);
+		std::vector<float> values(sizeY);
+		std::vector<uint8_t> columnKeep(sizeY);
+		std::vector<Run> columnRuns;
+		std::vector<uint8_t> columnLiterals;
+		for (int x = 0; x < sizeX; ++x){
+			for (int z = 0; z < sizeZ; ++z){
+				for (int y = 0; y < sizeY; ++y){
+					values[y] = density.get(x, y + minY - low, z);
+					columnKeep[y] = keep[density.index(x, y + minY - low, z)];
+				}
+				EncodeColumn(values.data(), columnKeep.data(), isoLevel, columnRuns, columnLiterals);
+
+				size_t column = ColumnIndex(x, z);
+				runs.insert(runs.end(), columnRuns.begin(), columnRuns.end());
+				literals.insert(literals.end(), columnLiterals.begin(), columnLiterals.end());
+				columnRunStart[column + 1] = static_cast<uint32_t>(runs.size());
+				columnLiteralStart[column + 1] = static_cast<uint32_t>(literals.size());
+			}
+		}
+		runs.shrink_to_fit();
+		literals.shrink_to_fit();
+	}
+
+	void Decompress(ChunkDensity& density) const {
+		density = ChunkDensity(sizeX, sizeY, sizeZ);
+		std::vector<float> values(sizeY);
+		for (int x = 0; x < sizeX; ++x){
+			for (int z = 0; z < sizeZ; ++z){
+				DecodeColumn(x, z, values.data());
+				for (int y = 0; y < sizeY; ++y) density.set(x, y, z, values[y]);
+			}
+		}
+	}
+
+	// Random access, a binary search over the few runs of one column
+	float get(int x, int y, int z) const {
+		size_t column = ColumnIndex(x, z);
+		const Run* first = runs.data() + columnRunStart[column];
+		const Run* last = runs.data() + columnRunStart[column + 1];
+		const Run* run = std::upper_bound(first, last, y,
+			[](int value, const Run& r) {return value < r.startY;}) - 1;
+
+		switch (run->kind){
+			case RunKind::Air: return airValue;
+			case RunKind::Solid: return solidValue;
+			default: return ReadLiteral(columnLiteralStart[column], run->literalOffset + (y - run->startY));
+		}
+	}
+
+	// Writes a single value, the column is re-encoded with the new value kept exact
+	void set(int x, int y, int z, float value, float isoLevel) {
+		std::vector<float> values(sizeY);
+		std::vector<uint8_t> keep(sizeY);
+		DecodeColumn(x, z, values.data(), keep.data());
+		values[y] = value;
+		keep[y] = 1;
+
+		std::vector<Run> columnRuns;
+		std::vector<uint8_t> columnLiterals;
+		EncodeColumn(values.data(), keep.data(), isoLevel, columnRuns, columnLiterals);
+		ReplaceColumn(ColumnIndex(x, z), columnRuns, columnLiterals);
+	}
+
+	// Writes the values flagged in written along one column, re-encoding it once
+	void SetColumn(int x, int z, const float* values, const uint8_t* written, float isoLevel) {
+		std::vector<float> column(sizeY);
+		std::vector<uint8_t> keep(sizeY);
+		DecodeColumn(x, z, column.data(), keep.data());
+		for (int y = 0; y < sizeY; ++y){
+			if (!written[y]) continue;
+			column[y] = values[y];
+			keep[y] = 1;
+		}
+
+		std::vector<Run> columnRuns;
+		std::vector<uint8_t> columnLiterals;
+		EncodeColumn(column.data(), keep.data(), isoLevel, columnRuns, columnLiterals);
+		ReplaceColumn(ColumnIndex(x, z), columnRuns, columnLiterals);
+	}
+
+	// Decodes all sizeY values of a column, literal is optionally set to 1 where the value is stored exactly
+	void DecodeColumn(int x, int z, float* out, uint8_t* literal = nullptr) const {
+		size_t column = ColumnIndex(x, z);
+		for (uint32_t r = columnRunStart[column]; r < columnRunStart[column + 1]; ++r){
+			const Run& run = runs[r];
+			for (int i = 0; i < run.length; ++i){
+				float value = run.kind == RunKind::Air ? airValue : run.kind == RunKind::Solid ? solidValue : ReadLiteral(columnLiteralStart[column], run.literalOffset + i);
+				out[run.startY + i] = value;
+				if (literal) literal[run.startY + i] = run.kind == RunKind::Literal;
+			}
+		}
+	}
+
+	MemoryStats GetMemoryStats() const {
+		MemoryStats stats;
+		stats.uncompressedBytes = static_cast<size_t>(sizeX) * sizeY * sizeZ * sizeof(float);
+		stats.compressedBytes = sizeof(*this)
+			+ runs.capacity() * sizeof(Run)
+			+ literals.capacity()
+			+ (columnRunStart.capacity() + columnLiteralStart.capacity()) * sizeof(uint32_t);
+		stats.runCount = runs.size();
+		stats.literalCount = literals.size() / static_cast<size_t>(precision);
+		return stats;
+	}
+
+	bool empty() const {return columnRunStart.empty();}
+	int getSizeX() const {return sizeX;}
+	int getSizeY() const {return sizeY;}
+	int getSizeZ() const {return sizeZ;}
+
+private:
+
+	enum class RunKind : uint8_t { Air, Solid, Literal };
+
+	struct Run{
+		uint16_t startY;
+		uint16_t length;
+		RunKind kind;
+		uint32_t literalOffset; // first value, relative to the column's literals
+	};
+
+	int sizeX = 0;
+	int sizeY = 0;
+	int sizeZ = 0;
+	Precision precision = Precision::Bits16;
+
+	// All columns packed back to back, column c owns runs [columnRunStart[c], columnRunStart[c+1])
+	std::vector<Run> runs;
+	std::vector<uint8_t> literals;
+	std::vector<uint32_t> columnRunStart;
+	std::vector<uint32_t> columnLiteralStart;
+
+
+	size_t ColumnIndex(int x, int z) const {return static_cast<size_t>(x) * sizeZ + z;}
+
+	float ReadLiteral(uint32_t columnStart, uint32_t index) const {
+		if (precision == Precision::Bits8) return literals[columnStart + index] / 255.0f;
+		const uint8_t* bytes = literals.data() + columnStart + index * 2;
+		uint16_t value = static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+		return value / 65535.0f;
+	}
+
+	static float Steps(Precision precision) {return precision == Precision::Bits8 ? 255.0f : 65535.0f;}
+
+	// Quantises without moving the value across isoLevel, so the mesh topology is preserved
+	static float LiteralSteps(float value, float isoLevel, Precision precision) {
+		const float steps = Steps(precision);
+		bool below = value < isoLevel;
+		float quantised = std::round(std::clamp(value, 0.0f, 1.0f) * steps);
+		if (below && quantised / steps >= isoLevel) quantised -= 1.0f;
+		if (!below && quantised / steps < isoLevel) quantised += 1.0f;
+		return quantised;
+	}
+
+	void WriteLiteral(std::vector<uint8_t>& out, float value, float isoLevel) const {
+		float quantised = LiteralSteps(value, isoLevel, precision);
+		if (precision == Precision::Bits8){
+			out.push_back(static_cast<uint8_t>(quantised));
+			return;
+		}
+		uint16_t bits = static_cast<uint16_t>(quantised);
+		out.push_back(static_cast<uint8_t>(bits & 0xFF));
+		out.push_back(static_cast<uint8_t>(bits >> 8));
+	}
+
+	void EncodeColumn(const float* values, const uint8_t* keep, float isoLevel, std::vector<Run>& columnRuns, std::vector<uint8_t>& columnLiterals) const {
+		columnRuns.clear();
+		columnLiterals.clear();
+
+		for (int y = 0; y < sizeY; ++y){
+			RunKind kind = keep[y] ? RunKind::Literal : (values[y] < isoLevel ? RunKind::Air : RunKind::Solid);
+
+			if (columnRuns.empty() || columnRuns.back().kind != kind){
+				uint32_t literalOffset = static_cast<uint32_t>(columnLiterals.size() / static_cast<size_t>(precision));
+				columnRuns.push_back(Run{static_cast<uint16_t>(y), 0, kind, literalOffset});
+			}
+			columnRuns.back().length++;
+			if (kind == RunKind::Literal) WriteLiteral(columnLiterals, values[y], isoLevel);
+		}
+	}
+
+	// Splices a re-encoded column into the packed arrays and shifts the columns after it
+	void ReplaceColumn(size_t column, const std::vector<Run>& columnRuns, const std::vector<uint8_t>& columnLiterals) {
+		uint32_t runBegin = columnRunStart[column];
+		uint32_t runEnd = columnRunStart[column + 1];
+		uint32_t literalBegin = columnLiteralStart[column];
+		uint32_t literalEnd = columnLiteralStart[column + 1];
+
+		runs.erase(runs.begin() + runBegin, runs.begin() + runEnd);
+		runs.insert(runs.begin() + runBegin, columnRuns.begin(), columnRuns.end());
+		literals.erase(literals.begin() + literalBegin, literals.begin() + literalEnd);
+		literals.insert(literals.begin() + literalBegin, columnLiterals.begin(), columnLiterals.end());
+
+		int64_t runDelta = static_cast<int64_t>(columnRuns.size()) - (runEnd - runBegin);
+		int64_t literalDelta = static_cast<int64_t>(columnLiterals.size()) - (literalEnd - literalBegin);
+		for (size_t c = column + 1; c < columnRunStart.size(); ++c){
+			columnRunStart[c] = static_cast<uint32_t>(columnRunStart[c] + runDelta);
+			columnLiteralStart[c] = static_cast<uint32_t>(columnLiteralStart[c] + literalDelta);
+		}
+	}
+
+	// Marks corners on a crossing edge plus their 6 neighbours
+	static std::vector<uint8_t> SurfaceBand(const ChunkDensity& density, float isoLevel) {
+		std::vector<uint8_t> crossing(density.count(), 0);
+		const int axis[3][3] = {{1,0,0}, {0,1,0}, {0,0,1}};
+
+		for (int x = 0; x < density.sizeX; ++x){
+			for (int y = 0; y < density.sizeY; ++y){
+				for (int z = 0; z < density.sizeZ; ++z){
+					bool below = density.get(x, y, z) < isoLevel;
+					for (const auto& a : axis){
+						int nx = x + a[0], ny = y + a[1], nz = z + a[2];
+						if (nx >= density.sizeX || ny >= density.sizeY || nz >= density.sizeZ) continue;
+						if ((density.get(nx, ny, nz) < isoLevel) != below){
+							crossing[density.index(x, y, z)] = 1;
+							crossing[density.index(nx, ny, nz)] = 1;
+						}
+					}
+				}
+			}
+		}
+
+		std::vector<uint8_t> keep(crossing);
+		for (int x = 0; x < density.sizeX; ++x){
+			for (int y = 0; y < density.sizeY; ++y){
+				for (int z = 0; z < density.sizeZ; ++z){
+					if (!crossing[density.index(x, y, z)]) continue;
+					for (const auto& a : axis){
+						for (int sign = -1; sign <= 1; sign += 2){
+							int nx = x + a[0] * sign, ny = y + a[1] * sign, nz = z + a[2] * sign;
+							if (nx < 0 || ny < 0 || nz < 0 || nx >= density.sizeX || ny >= density.sizeY || nz >= density.sizeZ) continue;
+							keep[density.index(nx, ny, nz)] = 1;
+						}
+					}
+				}
+			}
+		}
+		return keep;
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,184 @@
+#ifndef DUAL_MESHER_H
+#define DUAL_MESHER_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "chunk_density.h"
+#include "terrain_settings.h"
+#include "marching_cubes.h"
+#include "octahedral.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+// Surface nets and dual contouring over a ChunkDensity lattice.
+// One vertex per cell the surface passes through and one quad per lattice edge it crosses,
+// joining the four cells around the edge. Surface nets puts the vertex at the mean of the
+// cell's edge crossings, dual contouring minimises the distance to the tangent planes at the
+// crossings (a QEF), which keeps ridges and cave rims sharp. Neither leaves the slivers
+// marching cubes cuts where the surface passes close to a corner.
+//
+// Edge (c, axis) is owned by cell c minus one along the two other axes, so cell boxes that
+// tile a chunk mesh every edge once. The quads of a box reach one cell past its far faces,
+// a chunk lattice needs one more corner beyond +X and +Z to close against the next chunk.
+class DualMesher{
+public:
+
+	// Meshes the edges owned by cells [cellMin, cellMax), cells [cellMin, cellMax] must have all their corners.
+	// Positions are relative to corner (0,0,0) in lattice units times step, like MarchingCubes.
+	static void Polygonise(const ChunkDensity& density, const TerrainSettings& settings, bool solveQef, const glm::ivec3& cellMin, const glm::ivec3& cellMax, std::vector<TerrainVertex>& vertices, float step = 1.0f) {
+		glm::ivec3 cells{density.sizeX - 1, density.sizeY - 1, density.sizeZ - 1};
+
+		// Cell vertices are solved once, on first use
+		glm::ivec3 cacheSize = glm::max(cellMax - cellMin + 1, glm::ivec3(0));
+		std::vector<int> cache(static_cast<size_t>(cacheSize.x) * cacheSize.y * cacheSize.z, unsolved);
+		std::vector<TerrainVertex> cellVertices;
+		auto cellVertex = [&](const glm::ivec3& cell) {
+			glm::ivec3 local = cell - cellMin;
+			int& slot = cache[(static_cast<size_t>(local.x) * cacheSize.y + local.y) * cacheSize.z + local.z];
+			if (slot == unsolved){
+				TerrainVertex vertex;
+				slot = CellVertex(density, settings, solveQef, cell, step, vertex) ? static_cast<int>(cellVertices.size()) : noVertex;
+				if (slot != noVertex) cellVertices.push_back(vertex);
+			}
+			return slot;
+		};
+
+		for (int axis = 0; axis < 3; ++axis){
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			glm::ivec3 low = cellMin;
+			glm::ivec3 high = cellMax;
+			low[u]++; high[u]++;
+			low[v]++; high[v]++;
+
+			// Edges whose cells or far corner fall off the lattice are left to nobody
+			high = glm::min(high, cells);
+			glm::ivec3 along{0}, offsetU{0}, offsetV{0};
+			along[axis] = 1;
+			offsetU[u] = 1;
+			offsetV[v] = 1;
+
+			for (int x = low.x; x < high.x; ++x){
+				for (int y = low.y; y < high.y; ++y){
+					for (int z = low.z; z < high.z; ++z){
+						glm::ivec3 corner{x, y, z};
+						glm::ivec3 next = corner + along;
+						bool solid = density.get(x, y, z) >= settings.isoLevel;
+						if (solid == (density.get(next.x, next.y, next.z) >= settings.isoLevel)) continue;
+
+						// Counter clockwise seen from +axis, the outward side when the edge leaves the ground
+						int slots[4] = {
+							cellVertex(corner - offsetU - offsetV),
+							cellVertex(corner - offsetV),
+							cellVertex(corner),
+							cellVertex(corner - offsetU)};
+						if (std::any_of(slots, slots + 4, [](int slot) {return slot == noVertex;})) continue;
+						if (!solid) std::swap(slots[1], slots[3]);
+						const TerrainVertex& q0 = cellVertices[slots[0]];
+						const TerrainVertex& q1 = cellVertices[slots[1]];
+						const TerrainVertex& q2 = cellVertices[slots[2]];
+						const TerrainVertex& q3 = cellVertices[slots[3]];
+
+						// Split along the shorter diagonal
+						if (glm::length(q0.position - q2.position) <= glm::length(q1.position - q3.position)){
+							vertices.insert(vertices.end(), {q0, q1, q2, q0, q2, q3});
+						}
+						else {
+							vertices.insert(vertices.end(), {q0, q1, q3, q1, q2, q3});
+						}
+					}
+				}
+			}
+		}
+	}
+
+private:
+	static constexpr int unsolved = -1;
+	static constexpr int noVertex = -2;
+
+	// Keeps vertices off the cell faces, the lowest cell of a triangle's vertices is then its owner
+	static constexpr float cellMargin = 0.01f;
+
+	// Pulls the QEF towards the mean of the crossings, flat or nearly flat cells stay solvable
+	static constexpr float qefBias = 0.1f;
+
+	// False when the surface does not pass through the cell.
+	// Crossings and their gradients only use the cell's own corners, so the chunks on
+	// either side of a face place a cell's vertex identically.
+	static bool CellVertex(const ChunkDensity& density, const TerrainSettings& settings, bool solveQef, const glm::ivec3& cell, float step, TerrainVertex& vertex) {
+		// Corner i sits at offset (i & 1, (i >> 1) & 1, (i >> 2) & 1)
+		float values[8];
+		int solidCorners = 0;
+		for (int i = 0; i < 8; ++i){
+			values[i] = density.get(cell.x + (i & 1), cell.y + ((i >> 1) & 1), cell.z + ((i >> 2) & 1));
+			if (values[i] >= settings.isoLevel) solidCorners++;
+		}
+		if (solidCorners == 0 || solidCorners == 8) return false;
+
+		glm::vec3 points[12];
+		glm::vec3 normals[12];
+		int crossings = 0;
+		glm::vec3 massPoint{0.0f};
+		glm::vec3 gradientSum{0.0f};
+		for (int a = 0; a < 8; ++a){
+			for (int bit = 1; bit < 8; bit <<= 1){
+				if (a & bit) continue;
+				int b = a | bit;
+				if ((values[a] >= settings.isoLevel) == (values[b] >= settings.isoLevel)) continue;
+
+				float t = (settings.isoLevel - values[a]) / (values[b] - values[a]);
+				glm::vec3 point = glm::mix(CornerOffset(a), CornerOffset(b), t);
+				glm::vec3 gradient = CellGradient(values, point);
+				points[crossings] = point;
+				normals[crossings] = glm::length(gradient) > 1e-6f ? glm::normalize(gradient) : glm::vec3{0.0f};
+				massPoint += point;
+				gradientSum += gradient;
+				crossings++;
+			}
+		}
+		massPoint /= static_cast<float>(crossings);
+
+		glm::vec3 position = massPoint;
+		if (solveQef){
+			// Least squares over the crossing planes, solved for the offset from the mass point
+			glm::mat3 ata{qefBias};
+			glm::vec3 atb{0.0f};
+			for (int i = 0; i < crossings; ++i){
+				ata += glm::outerProduct(normals[i], normals[i]);
+				atb += normals[i] * glm::dot(normals[i], points[i] - massPoint);
+			}
+			position = massPoint + glm::inverse(ata) * atb;
+		}
+		position = glm::clamp(position, cellMargin, 1.0f - cellMargin);
+
+		// Density increases into the ground, the surface faces down the gradient
+		float length = glm::length(gradientSum);
+		vertex.position = (glm::vec3(cell) + position) * step;
+		vertex.normal = OctahedralNormal::Pack16(length > 1e-6f ? -gradientSum / length : glm::vec3{0.0f, 1.0f, 0.0f});
+		return true;
+	}
+
+	static glm::vec3 CornerOffset(int i) {
+		return {static_cast<float>(i & 1), static_cast<float>((i >> 1) & 1), static_cast<float>((i >> 2) & 1)};
+	}
+
+	// Gradient of the trilinear interpolation of the cell's corners at a point inside it
+	static glm::vec3 CellGradient(const float values[8], const glm::vec3& p) {
+		glm::vec3 gradient{0.0f};
+		for (int i = 0; i < 8; ++i){
+			glm::vec3 corner = CornerOffset(i);
+			glm::vec3 weight = glm::mix(1.0f - p, p, corner);
+			glm::vec3 sign = corner * 2.0f - 1.0f;
+			gradient += values[i] * sign * glm::vec3{weight.y * weight.z, weight.x * weight.z, weight.x * weight.y};
+		}
+		return gradient;
+	}
+};
+
+} // namespace
+#endif
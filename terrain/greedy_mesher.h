@@ -0,0 +1,177 @@
+#ifndef GREEDY_MESHER_H
+#define GREEDY_MESHER_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "chunk_density.h"
+#include "terrain_settings.h"
+#include "marching_cubes.h"
+#include "octahedral.h"
+#include "ambient_occlusion.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+// Block voxels over a ChunkDensity lattice, every cell is a block that is solid when the
+// density at its centre (the mean of its corners) reaches isoLevel. Faces between a solid
+// and an air block are drawn and neighbouring faces on the same plane with the same
+// material and facing are merged into one quad.
+//
+// Blocks open to the sky are grass, or snow from snowMinHeightPercent of the world up,
+// everything under them is stone. Like DualMesher, the faces on plane k of an axis are
+// owned by cell k - 1 and a chunk lattice needs one more corner past its +X and +Z faces
+// to see the blocks across them. Merged quads never leave the cell box they were meshed for.
+// With an occlusion, only faces whose four corners are equally occluded merge, so the baked
+// shading of a merged quad is the shading of each face it covers.
+class GreedyMesher{
+public:
+
+	// Meshes the faces owned by cells [cellMin, cellMax), each face on its own when merge is false.
+	// Positions are relative to corner (0,0,0) in lattice units times step, like MarchingCubes.
+	static void Polygonise(const ChunkDensity& density, const TerrainSettings& settings, const glm::ivec3& cellMin, const glm::ivec3& cellMax, std::vector<TerrainVertex>& vertices, float step = 1.0f, bool merge = true, const LatticeOcclusion* occlusion = nullptr) {
+		glm::ivec3 cells{density.sizeX - 1, density.sizeY - 1, density.sizeZ - 1};
+
+		// Block materials of the cells the faces touch, one past the box on every axis, air off the lattice
+		glm::ivec3 size = cellMax - cellMin + 1;
+		std::vector<TerrainMaterial> blocks(static_cast<size_t>(size.x) * size.y * size.z, air);
+		float snowMinY = settings.snowMinHeightPercent * settings.worldHeight;
+		for (int x = 0; x < size.x && cellMin.x + x < cells.x; ++x){
+			for (int z = 0; z < size.z && cellMin.z + z < cells.z; ++z){
+				// The highest solid block of the column is open to the sky, caves below stay stone
+				bool covered = false;
+				for (int y = cells.y - 1; y >= cellMin.y; --y){
+					if (!Solid(density, settings, cellMin.x + x, y, cellMin.z + z)) continue;
+					if (y - cellMin.y < size.y){
+						TerrainMaterial top = (y + 0.5f) * step >= snowMinY ? TerrainMaterial::Snow : TerrainMaterial::Grass;
+						blocks[((static_cast<size_t>(x) * size.y) + y - cellMin.y) * size.z + z] = covered ? TerrainMaterial::Stone : top;
+					}
+					covered = true;
+				}
+			}
+		}
+		auto block = [&](const glm::ivec3& cell) {
+			glm::ivec3 local = cell - cellMin;
+			return blocks[((static_cast<size_t>(local.x) * size.y) + local.y) * size.z + local.z];
+		};
+
+		std::vector<uint32_t> mask;
+		for (int axis = 0; axis < 3; ++axis){
+			int u = (axis + 1) % 3;
+			int v = (axis + 2) % 3;
+			int width = cellMax[u] - cellMin[u];
+			int height = cellMax[v] - cellMin[v];
+			mask.assign(static_cast<size_t>(width) * height, 0);
+
+			// Plane k lies between cells k - 1 and k, the bottom of the world is never seen
+			for (int plane = cellMin[axis] + 1; plane <= cellMax[axis]; ++plane){
+				// Face material, facing and occlusion on the plane, 0 for none
+				for (int i = 0; i < width; ++i){
+					for (int j = 0; j < height; ++j){
+						glm::ivec3 above = cellMin;
+						above[axis] = plane;
+						above[u] += i;
+						above[v] += j;
+						glm::ivec3 below = above;
+						below[axis]--;
+						TerrainMaterial low = block(below);
+						TerrainMaterial high = block(above);
+						uint32_t face = 0;
+						if (low != air && high == air) face = FaceCode(low, true);
+						else if (low == air && high != air) face = FaceCode(high, false);
+						if (face != 0 && occlusion) face |= OcclusionCode(*occlusion, glm::vec3(above), u, v);
+						mask[i * height + j] = face;
+					}
+				}
+
+				for (int i = 0; i < width; ++i){
+					for (int j = 0; j < height; ++j){
+						uint32_t face = mask[i * height + j];
+						if (face == 0) continue;
+
+						// Grow along v, then along u while the whole run matches, a merged quad's corners
+						// carry the occlusion of the faces in them only where it does not change along the merge
+						int runV = 1;
+						while (merge && EvenAlongV(face) && j + runV < height && mask[i * height + j + runV] == face) runV++;
+						int runU = 1;
+						while (merge && EvenAlongU(face) && i + runU < width && std::all_of(mask.begin() + (i + runU) * height + j, mask.begin() + (i + runU) * height + j + runV, [face](uint32_t f) {return f == face;})) runU++;
+						for (int a = i; a < i + runU; ++a) std::fill(mask.begin() + a * height + j, mask.begin() + a * height + j + runV, 0);
+
+						glm::vec3 origin{cellMin};
+						origin[axis] = static_cast<float>(plane);
+						origin[u] += i;
+						origin[v] += j;
+						glm::vec3 spanU{0.0f}, spanV{0.0f};
+						spanU[u] = static_cast<float>(runU);
+						spanV[v] = static_cast<float>(runV);
+						EmitQuad(origin * step, spanU * step, spanV * step, axis, face, vertices);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	// No block is shaded by the slope rules, it marks air
+	static constexpr TerrainMaterial air = TerrainMaterial::Shaded;
+
+	static bool Solid(const ChunkDensity& density, const TerrainSettings& settings, int x, int y, int z) {
+		float sum = 0.0f;
+		for (int i = 0; i < 8; ++i) sum += density.get(x + (i & 1), y + ((i >> 1) & 1), z + ((i >> 2) & 1));
+		return sum * 0.125f >= settings.isoLevel;
+	}
+
+	// Material in the high bits, facing +axis in the low one, never 0
+	static uint8_t FaceCode(TerrainMaterial material, bool positive) {
+		return static_cast<uint8_t>(static_cast<uint8_t>(material) << 1 | (positive ? 1 : 0));
+	}
+
+	// Block faces are shaded in a few steps, finer ones would stop most faces from merging
+	static constexpr int occlusionLevels = 4;
+
+	static int OcclusionLevel(const LatticeOcclusion& occlusion, const glm::vec3& corner) {
+		return (occlusion.At(corner) * (occlusionLevels - 1) + 127) / 255;
+	}
+
+	// Occlusion levels of a face's corners at origin, +u, +v and +u+v, four bits each above the face code
+	static uint32_t OcclusionCode(const LatticeOcclusion& occlusion, const glm::vec3& corner, int u, int v) {
+		glm::vec3 offsetU{0.0f}, offsetV{0.0f};
+		offsetU[u] = 1.0f;
+		offsetV[v] = 1.0f;
+		return static_cast<uint32_t>(OcclusionLevel(occlusion, corner)) << 8
+			| static_cast<uint32_t>(OcclusionLevel(occlusion, corner + offsetU)) << 12
+			| static_cast<uint32_t>(OcclusionLevel(occlusion, corner + offsetV)) << 16
+			| static_cast<uint32_t>(OcclusionLevel(occlusion, corner + offsetU + offsetV)) << 20;
+	}
+
+	static uint8_t CornerOcclusion(uint32_t face, int corner) {
+		return static_cast<uint8_t>(((face >> (8 + 4 * corner)) & 0xf) * 255 / (occlusionLevels - 1));
+	}
+
+	// Faces repeat along u when each of their u edges is evenly occluded, along v likewise
+	static bool EvenAlongU(uint32_t face) {return ((face >> 8) & 0xf) == ((face >> 12) & 0xf) && ((face >> 16) & 0xf) == ((face >> 20) & 0xf);}
+	static bool EvenAlongV(uint32_t face) {return ((face >> 8) & 0xf) == ((face >> 16) & 0xf) && ((face >> 12) & 0xf) == ((face >> 20) & 0xf);}
+
+	// spanU and spanV go counter clockwise seen from +axis
+	static void EmitQuad(const glm::vec3& origin, const glm::vec3& spanU, const glm::vec3& spanV, int axis, uint32_t face, std::vector<TerrainVertex>& vertices) {
+		bool positive = face & 1;
+		glm::vec3 normal{0.0f};
+		normal[axis] = positive ? 1.0f : -1.0f;
+		TerrainVertex corner{origin, OctahedralNormal::Pack16(normal), static_cast<TerrainMaterial>((face & 0xff) >> 1)};
+		TerrainVertex q0 = corner, q1 = corner, q2 = corner, q3 = corner;
+		q1.position += spanU;
+		q2.position += spanU + spanV;
+		q3.position += spanV;
+		q0.occlusion = CornerOcclusion(face, 0);
+		q1.occlusion = CornerOcclusion(face, 1);
+		q2.occlusion = CornerOcclusion(face, 3);
+		q3.occlusion = CornerOcclusion(face, 2);
+		if (positive) vertices.insert(vertices.end(), {q0, q1, q2, q0, q2, q3});
+		else vertices.insert(vertices.end(), {q0, q2, q1, q0, q3, q2});
+	}
+};
+
+} // namespace
+#endif
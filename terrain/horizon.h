@@ -0,0 +1,204 @@
+#ifndef HORIZON_H
+#define HORIZON_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "terrain_settings.h"
+#include "marching_cubes.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+namespace Engine{
+
+// Distant terrain past the chunk range, built from the 2D surface heights alone.
+//
+// A geometry clipmap: level L is a square grid of cells baseSpacing * 2^L wide centred
+// near the player, with the area of level L-1 cut out of it. Level 0 is cut around the
+// chunk range, which the real chunks fill. Every level goes into one vertex list so the
+// whole horizon is a single draw.
+//
+// Every vertex also carries the height the next level interpolates at it. The vertex shader
+// morphs towards that height as the camera's distance nears the level's edge, every frame,
+// so levels meet without cracks and detail fades in without popping when a level shifts.
+class HorizonClipmap{
+public:
+
+	struct MorphTarget{
+		float height;	// relative to getOrigin() like the positions
+		uint8_t level;
+	};
+
+	// The camera is within two cells of a level's snapped centre, so its edge is never nearer
+	// than ringCells - 2 and the cut out finer level never further than ringCells / 2 + 1.
+	// Morphing runs between the two, over at most the outer quarter.
+	static float MorphStart(int ringCells) {return std::max(ringCells / 2.0f + 1.0f, MorphEnd(ringCells) - ringCells / 4.0f);}
+	static float MorphEnd(int ringCells) {return ringCells - 2.0f;}
+
+	// surfaceHeight(x, z) is the terrain's surface height at a world position.
+	// Returns true when the vertices changed and need uploading again.
+	template<typename Sampler>
+	bool Update(const TerrainSettings& settings, glm::vec2 player, glm::vec2 chunkRangeMin, glm::vec2 chunkRangeMax, Sampler&& surfaceHeight) {
+		float baseSpacing = static_cast<float>(settings.chunkSize);
+		int levelCount = std::max(1, settings.horizonLevels);
+
+		// Level 0 has to reach past the chunk range, and every level past the one inside it
+		float chunkRangeHalf = std::max(chunkRangeMax.x - chunkRangeMin.x, chunkRangeMax.y - chunkRangeMin.y) / 2.0f;
+		int ringCells = std::max({settings.horizonRingCells, static_cast<int>(std::ceil(chunkRangeHalf / baseSpacing)) + 4, 8});
+		ringCells += ringCells % 2;
+
+		bool changed = levels.size() != static_cast<size_t>(levelCount) || ringCells != levelRingCells || chunkRangeMin != holeMin || chunkRangeMax != holeMax;
+		levels.resize(levelCount);
+		levelRingCells = ringCells;
+		holeMin = chunkRangeMin;
+		holeMax = chunkRangeMax;
+
+		for (int l = 0; l < levelCount; ++l){
+			Level& level = levels[l];
+			float spacing = baseSpacing * static_cast<float>(1 << l);
+
+			// Snapped to every other node so the finer level's edge lands on this level's nodes
+			glm::ivec2 centre = glm::ivec2(glm::floor(player / (2.0f * spacing))) * 2;
+			if (level.spacing == spacing && level.centre == centre && !level.heights.empty()) continue;
+
+			level.spacing = spacing;
+			level.centre = centre;
+			SampleHeights(level, settings, surfaceHeight);
+			changed = true;
+		}
+
+		if (changed) BuildVertices();
+		return changed;
+	}
+
+	// Positions are relative to getOrigin() and lie within getExtent() of it
+	const std::vector<TerrainVertex>& getVertices() const {return vertices;}
+	const std::vector<MorphTarget>& getMorphTargets() const {return morphTargets;}	// one per vertex
+	int getRingCells() const {return levelRingCells;}	// cells from a level's centre to its edge
+	const glm::vec3& getOrigin() const {return origin;}
+	const glm::vec3& getExtent() const {return extent;}
+	size_t getSampleCount() const {return samples;}
+
+private:
+
+	struct Level{
+		float spacing = 0.0f;
+		glm::ivec2 centre{0}; // node index, in units of spacing
+		std::vector<float> heights; // nodes centre - ringCells - 1 to centre + ringCells + 1 on both axes
+	};
+
+	std::vector<Level> levels;
+	std::vector<TerrainVertex> vertices;
+	std::vector<MorphTarget> morphTargets;
+	glm::vec3 origin{0.0f};
+	glm::vec3 extent{0.0f};
+	int levelRingCells = 0;
+	glm::vec2 holeMin{0.0f};
+	glm::vec2 holeMax{0.0f};
+	size_t samples = 0;
+
+
+	int NodesPerSide() const {return 2 * levelRingCells + 3;}
+
+	// Height of node (i, j) relative to the level's centre, i and j in [-ringCells - 1, ringCells + 1]
+	float Height(const Level& level, int i, int j) const {
+		int side = NodesPerSide();
+		return level.heights[(i + levelRingCells + 1) * side + (j + levelRingCells + 1)];
+	}
+
+	template<typename Sampler>
+	void SampleHeights(Level& level, const TerrainSettings& settings, Sampler& surfaceHeight) {
+		int side = NodesPerSide();
+		level.heights.resize(static_cast<size_t>(side) * side);
+		for (int i = 0; i < side; ++i){
+			for (int j = 0; j < side; ++j){
+				float x = (level.centre.x + i - levelRingCells - 1) * level.spacing;
+				float z = (level.centre.y + j - levelRingCells - 1) * level.spacing;
+
+				// Sunk a little so the real chunks win where the two overlap
+				level.heights[i * side + j] = surfaceHeight(x, z) - settings.horizonSinkDepth;
+			}
+		}
+		samples += level.heights.size();
+	}
+
+	// Height the next level draws at node (i, j), its cells share the diagonal used below
+	float CoarseHeight(const Level& level, int i, int j) const {
+		bool oddI = ((level.centre.x + i) & 1) != 0;
+		bool oddJ = ((level.centre.y + j) & 1) != 0;
+		if (oddI && oddJ) return (Height(level, i - 1, j + 1) + Height(level, i + 1, j - 1)) / 2.0f;
+		if (oddI) return (Height(level, i - 1, j) + Height(level, i + 1, j)) / 2.0f;
+		if (oddJ) return (Height(level, i, j - 1) + Height(level, i, j + 1)) / 2.0f;
+		return Height(level, i, j);
+	}
+
+	void AddVertex(const Level& level, uint8_t levelIndex, int i, int j) {
+		float x = (level.centre.x + i) * level.spacing;
+		float z = (level.centre.y + j) * level.spacing;
+
+		glm::vec3 normal{
+			Height(level, i - 1, j) - Height(level, i + 1, j),
+			2.0f * level.spacing,
+			Height(level, i, j - 1) - Height(level, i, j + 1)};
+		vertices.push_back({{x, Height(level, i, j), z}, OctahedralNormal::Pack16(glm::normalize(normal))});
+		morphTargets.push_back({CoarseHeight(level, i, j), levelIndex});
+	}
+
+	// Cells entirely inside the finer level, or the chunk range for level 0, are left out
+	void BuildVertices() {
+		vertices.clear();
+		morphTargets.clear();
+		for (size_t l = 0; l < levels.size(); ++l){
+			const Level& level = levels[l];
+			glm::vec2 innerMin = holeMin;
+			glm::vec2 innerMax = holeMax;
+			if (l > 0){
+				const Level& finer = levels[l - 1];
+				innerMin = (glm::vec2(finer.centre) - static_cast<float>(levelRingCells)) * finer.spacing;
+				innerMax = (glm::vec2(finer.centre) + static_cast<float>(levelRingCells)) * finer.spacing;
+			}
+			else {
+				// Reach one cell under the chunks so there is no gap at their edge
+				innerMin += level.spacing;
+				innerMax -= level.spacing;
+			}
+
+			for (int i = -levelRingCells; i < levelRingCells; ++i){
+				for (int j = -levelRingCells; j < levelRingCells; ++j){
+					glm::vec2 cellMin = glm::vec2(level.centre + glm::ivec2(i, j)) * level.spacing;
+					glm::vec2 cellMax = cellMin + level.spacing;
+					if (cellMin.x >= innerMin.x && cellMin.y >= innerMin.y && cellMax.x <= innerMax.x && cellMax.y <= innerMax.y) continue;
+
+					// Same winding as the chunk meshes, facing up
+					uint8_t levelIndex = static_cast<uint8_t>(l);
+					AddVertex(level, levelIndex, i, j);
+					AddVertex(level, levelIndex, i, j + 1);
+					AddVertex(level, levelIndex, i + 1, j);
+					AddVertex(level, levelIndex, i + 1, j);
+					AddVertex(level, levelIndex, i, j + 1);
+					AddVertex(level, levelIndex, i + 1, j + 1);
+				}
+			}
+		}
+
+		// Moved next to the origin so the positions quantise over the horizon's bounds alone
+		glm::vec3 boundsMin{std::numeric_limits<float>::max()};
+		glm::vec3 boundsMax{std::numeric_limits<float>::lowest()};
+		for (size_t v = 0; v < vertices.size(); ++v){
+			glm::vec3 target{vertices[v].position.x, morphTargets[v].height, vertices[v].position.z};
+			boundsMin = glm::min(boundsMin, glm::min(vertices[v].position, target));
+			boundsMax = glm::max(boundsMax, glm::max(vertices[v].position, target));
+		}
+		if (vertices.empty()) boundsMin = boundsMax = glm::vec3{0.0f};
+		for (TerrainVertex& vertex : vertices) vertex.position -= boundsMin;
+		for (MorphTarget& target : morphTargets) target.height -= boundsMin.y;
+		origin = boundsMin;
+		extent = boundsMax - boundsMin;
+	}
+};
+
+} // namespace
+#endif
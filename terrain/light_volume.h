@@ -0,0 +1,200 @@
+#ifndef LIGHT_VOLUME_H
+#define LIGHT_VOLUME_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "chunk_density.h"
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+namespace Engine{
+
+// Skylight and block light at the lattice corners of a chunk, levels 0 to 15 in a nibble each.
+// Light floods breadth first through air corners and drops one level per world unit, so a
+// lattice of spacing step loses step levels per corner. Skylight keeps full strength straight
+// down from the open sky and spreads sideways into caves and under overhangs like block light.
+// Light is taken back the same way, breadth first from the corners that lost it, and the
+// volume remembers the box of corners changed since it was last asked (see TakeTouched).
+class LightVolume{
+public:
+	static constexpr int maxLevel = 15;
+
+	// Shift of the channel's nibble
+	enum Channel : int {Block = 0, Sky = 4};
+
+	// A corner that went dark and the level it had
+	struct Removal {
+		glm::ivec3 corner;
+		int level;
+	};
+
+	LightVolume() = default;
+
+	bool empty() const {return values.empty();}
+	const glm::ivec3& Size() const {return size;}
+	size_t CornerCount() const {return values.size();}
+
+	int Get(Channel channel, const glm::ivec3& corner) const {return (values[Index(corner)] >> channel) & 0xf;}
+	bool Open(const glm::ivec3& corner) const {return open[Index(corner)] != 0;}
+	bool Inside(const glm::ivec3& corner) const {return glm::all(glm::greaterThanEqual(corner, glm::ivec3(0))) && glm::all(glm::lessThan(corner, size));}
+
+	// On the -X, +X, -Z or +Z face, shared with the chunk across it
+	bool OnSide(const glm::ivec3& corner) const {return corner.x == 0 || corner.z == 0 || corner.x == size.x - 1 || corner.z == size.z - 1;}
+
+	// Dark again, air corners of the lattice are open
+	void Reset(const ChunkDensity& lattice, float isoLevel) {
+		size = {lattice.sizeX, lattice.sizeY, lattice.sizeZ};
+		values.assign(lattice.count(), 0);
+		open.resize(lattice.count());
+		for (size_t i = 0; i < open.size(); ++i) open[i] = lattice.values[i] < isoLevel ? 1 : 0;
+		touchedMin = glm::ivec3(0);
+		touchedMax = size - 1;
+	}
+
+	// For a corner whose density crossed isoLevel, the light it had is left to the caller
+	void SetOpen(const glm::ivec3& corner, bool isOpen) {
+		open[Index(corner)] = isOpen ? 1 : 0;
+		Touch(corner);
+	}
+
+	// Brightens an open corner and queues it for Flood, false when it is solid or already as bright
+	bool Raise(Channel channel, const glm::ivec3& corner, int level, std::vector<glm::ivec3>& queue) {
+		size_t i = Index(corner);
+		if (!open[i] || level <= ((values[i] >> channel) & 0xf)) return false;
+		Set(channel, i, level);
+		Touch(corner);
+		queue.push_back(corner);
+		return true;
+	}
+
+	// Darkens a corner and queues it for Unflood, false when it was dark already
+	bool Lower(Channel channel, const glm::ivec3& corner, std::vector<Removal>& queue) {
+		size_t i = Index(corner);
+		int level = (values[i] >> channel) & 0xf;
+		if (level == 0) return false;
+		Set(channel, i, 0);
+		Touch(corner);
+		queue.push_back({corner, level});
+		return true;
+	}
+
+	// Skylight down every column until its first solid corner
+	void SeedSky(std::vector<glm::ivec3>& queue) {
+		for (int x = 0; x < size.x; ++x){
+			for (int z = 0; z < size.z; ++z){
+				for (int y = size.y - 1; y >= 0 && Raise(Sky, {x, y, z}, maxLevel, queue); --y){}
+			}
+		}
+	}
+
+	// Spreads the queued corners to their open neighbours, returns how many corners it brightened.
+	// Full skylight passes straight down undimmed. The queued and brightened corners on the side
+	// faces are added to sides when given, the chunks across need them too.
+	size_t Flood(Channel channel, int step, std::vector<glm::ivec3>& queue, std::vector<glm::ivec3>* sides = nullptr) {
+		static const glm::ivec3 neighbours[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+		size_t raised = 0;
+		for (size_t head = 0; head < queue.size(); ++head){
+			glm::ivec3 corner = queue[head];
+			if (sides && OnSide(corner)) sides->push_back(corner);
+			int current = Get(channel, corner);
+			for (const glm::ivec3& offset : neighbours){
+				glm::ivec3 next = corner + offset;
+				if (!Inside(next)) continue;
+				int level = Undimmed(channel, offset, current) ? current : current - step;
+				if (level > 0 && Raise(channel, next, level, queue)) raised++;
+			}
+		}
+		queue.clear();
+		return raised;
+	}
+
+	// Takes back the light that spread from the queued corners, returns how many corners it darkened.
+	// Neighbours dimmer than the corner they were lit from go dark in turn, brighter ones keep their
+	// own light and are queued on refill to flood back into the darkened corners afterwards. The
+	// darkened corners on the side faces are added to sides when given.
+	size_t Unflood(Channel channel, std::vector<Removal>& queue, std::vector<glm::ivec3>& refill, std::vector<Removal>* sides = nullptr) {
+		static const glm::ivec3 neighbours[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+		size_t darkened = 0;
+		for (size_t head = 0; head < queue.size(); ++head){
+			Removal removal = queue[head];
+			if (sides && OnSide(removal.corner)) sides->push_back(removal);
+			for (const glm::ivec3& offset : neighbours){
+				glm::ivec3 next = removal.corner + offset;
+				if (!Inside(next)) continue;
+				int level = Get(channel, next);
+				if (level == 0) continue;
+				if (level < removal.level || (level == removal.level && Undimmed(channel, offset, level))){
+					if (Lower(channel, next, queue)) darkened++;
+				}
+				else refill.push_back(next);
+			}
+		}
+		queue.clear();
+		return darkened;
+	}
+
+	// Box of the corners whose light or openness changed since the last call, false when none did
+	bool TakeTouched(glm::ivec3& low, glm::ivec3& high) {
+		if (touchedMin.x > touchedMax.x) return false;
+		low = touchedMin;
+		high = touchedMax;
+		touchedMin = glm::ivec3(std::numeric_limits<int>::max());
+		touchedMax = glm::ivec3(std::numeric_limits<int>::lowest());
+		return true;
+	}
+
+	// Light at a point in lattice units, interpolated over the open corners around it since the
+	// solid ones stay dark, 0 when there are none. Sky in the high nibble like the stored corners.
+	// A point on a lattice plane only reads the corners on the plane.
+	uint8_t At(const glm::vec3& position) const {
+		glm::vec3 p = glm::clamp(position, glm::vec3(0.0f), glm::vec3(size - 1));
+		glm::ivec3 low = glm::min(glm::ivec3(glm::floor(p)), glm::max(size - 2, glm::ivec3(0)));
+		glm::vec3 t = glm::min(p - glm::vec3(low), glm::vec3(1.0f));
+		float sky = 0.0f, block = 0.0f, weights = 0.0f;
+		for (int i = 0; i < 8; ++i){
+			glm::ivec3 offset{i & 1, (i >> 1) & 1, (i >> 2) & 1};
+			glm::ivec3 corner = glm::min(low + offset, size - 1);
+			if (!Open(corner)) continue;
+			glm::vec3 weight = glm::mix(1.0f - t, t, glm::vec3(offset));
+			float w = weight.x * weight.y * weight.z;
+			sky += Get(Sky, corner) * w;
+			block += Get(Block, corner) * w;
+			weights += w;
+		}
+		if (weights <= 0.0f) return 0;
+		int skyLevel = static_cast<int>(sky / weights + 0.5f);
+		int blockLevel = static_cast<int>(block / weights + 0.5f);
+		return static_cast<uint8_t>(skyLevel << Sky | blockLevel << Block);
+	}
+
+private:
+	glm::ivec3 size{0};
+	std::vector<uint8_t> values;	// sky << 4 | block
+	std::vector<uint8_t> open;
+	glm::ivec3 touchedMin{std::numeric_limits<int>::max()};
+	glm::ivec3 touchedMax{std::numeric_limits<int>::lowest()};
+
+	size_t Index(const glm::ivec3& corner) const {
+		return (static_cast<size_t>(corner.x) * size.y + corner.y) * size.z + corner.z;
+	}
+
+	void Set(Channel channel, size_t i, int level) {
+		values[i] = static_cast<uint8_t>((values[i] & ~(0xf << channel)) | (level << channel));
+	}
+
+	void Touch(const glm::ivec3& corner) {
+		touchedMin = glm::min(touchedMin, corner);
+		touchedMax = glm::max(touchedMax, corner);
+	}
+
+	// Full skylight going down keeps its strength
+	static bool Undimmed(Channel channel, const glm::ivec3& offset, int level) {
+		return channel == Sky && offset.y < 0 && level == maxLevel;
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,150 @@
+#ifndef MARCHING_CUBES_H
+#define MARCHING_CUBES_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "chunk_density.h"
+#include "terrain_settings.h"
+#include "tables.h"
+#include "octahedral.h"
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+// Smooth meshes leave the material to the terrain shaders, which pick it from the normal
+// and height. Block meshes name one for each face.
+enum class TerrainMaterial : uint8_t {Shaded, Stone, Grass, Snow};
+
+// Mesher output, TerrainModel quantises it for the GPU.
+struct TerrainVertex{
+	glm::vec3 position;
+	uint32_t normal = 0; // OctahedralNormal::Pack16
+	TerrainMaterial material = TerrainMaterial::Shaded;
+	uint8_t occlusion = 0; // LatticeOcclusion, 0 open to 255 enclosed
+	uint8_t light = 0xf0; // LightVolume, sky in the high nibble and block light in the low one
+};
+
+// CPU marching cubes over a ChunkDensity lattice.
+// Vertex positions are relative to the chunk origin, in lattice units times step.
+// step is the world spacing of the lattice, above 1 for coarse levels of detail.
+// Vertex normals come from the density gradient at the cube corners, central differences
+// of the lattice itself, interpolated along the edge like the position.
+class MarchingCubes{
+public:
+
+	// Lattice offsets of the 8 cube corners, same order as the TriTable corner indices
+	static constexpr int cornerOffsets[8][3] = {
+		{0,0,1}, {1,0,1}, {1,0,0}, {0,0,0},
+		{0,1,1}, {1,1,1}, {1,1,0}, {0,1,0}
+	};
+
+	static void Polygonise(const ChunkDensity& density, const TerrainSettings& settings, std::vector<TerrainVertex>& vertices, float step = 1.0f) {
+		PolygoniseRange(density, settings, 0, density.sizeY - 1, vertices, step);
+	}
+
+	// Only polygonise the cubes in layers [cubeMinY, cubeMaxY)
+	static void PolygoniseRange(const ChunkDensity& density, const TerrainSettings& settings, int cubeMinY, int cubeMaxY, std::vector<TerrainVertex>& vertices, float step = 1.0f) {
+		PolygoniseBox(density, settings, {0, cubeMinY, 0}, {density.sizeX - 1, cubeMaxY, density.sizeZ - 1}, vertices, step);
+	}
+
+	// Only polygonise the cubes in [cubeMin, cubeMax), the corners around them still feed the normals
+	static void PolygoniseBox(const ChunkDensity& density, const TerrainSettings& settings, const glm::ivec3& cubeMin, const glm::ivec3& cubeMax, std::vector<TerrainVertex>& vertices, float step = 1.0f) {
+		for (int x = cubeMin.x; x < cubeMax.x; ++x){
+			for (int y = cubeMin.y; y < cubeMax.y; ++y){
+				for (int z = cubeMin.z; z < cubeMax.z; ++z){
+					PolygoniseCube(density, settings, x, y, z, vertices, step);
+				}
+			}
+		}
+	}
+
+	static void PolygoniseCube(const ChunkDensity& density, const TerrainSettings& settings, int x, int y, int z, std::vector<TerrainVertex>& vertices, float step = 1.0f) {
+
+		float cornerValues[8];
+		int cubeIndex = 0;
+		for (int i = 0; i < 8; ++i){
+			cornerValues[i] = density.get(x + cornerOffsets[i][0], y + cornerOffsets[i][1], z + cornerOffsets[i][2]);
+			if (cornerValues[i] < settings.isoLevel) cubeIndex |= 1 << i;
+		}
+
+		// Entirely air or entirely solid
+		if (cubeIndex == 0 || cubeIndex == 255) return;
+
+		// Density increases into the ground, so the surface faces down the gradient
+		glm::vec3 cornerGradients[8];
+		glm::vec3 gradient{0.0f};
+		for (int i = 0; i < 8; ++i){
+			cornerGradients[i] = CornerGradient(density, x + cornerOffsets[i][0], y + cornerOffsets[i][1], z + cornerOffsets[i][2]);
+			gradient += cornerValues[i] * (glm::vec3(cornerOffsets[i][0], cornerOffsets[i][1], cornerOffsets[i][2]) - 0.5f);
+		}
+
+		glm::vec3 cubePosition{x, y, z};
+		for (int i = 0; TriTable[cubeIndex][i] != -1; i += 3){
+			glm::vec3 gradientA, gradientB, gradientC;
+			glm::vec3 a = (cubePosition + EdgePoint(cornerValues, cornerGradients, TriTable[cubeIndex][i], settings.isoLevel, gradientA)) * step;
+			glm::vec3 b = (cubePosition + EdgePoint(cornerValues, cornerGradients, TriTable[cubeIndex][i + 1], settings.isoLevel, gradientB)) * step;
+			glm::vec3 c = (cubePosition + EdgePoint(cornerValues, cornerGradients, TriTable[cubeIndex][i + 2], settings.isoLevel, gradientC)) * step;
+
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float length = glm::length(normal);
+			if (length <= 0.0f) continue; // degenerate sliver
+			normal /= length;
+
+			// Keep the winding consistent with the outward normal
+			if (glm::dot(normal, gradient) > 0.0f){
+				std::swap(b, c);
+				std::swap(gradientB, gradientC);
+				normal = -normal;
+			}
+
+			vertices.push_back({a, VertexNormal(gradientA, normal)});
+			vertices.push_back({b, VertexNormal(gradientB, normal)});
+			vertices.push_back({c, VertexNormal(gradientC, normal)});
+		}
+	}
+
+	// Density gradient at a lattice corner, central differences inside the lattice and one sided on its faces
+	static glm::vec3 CornerGradient(const ChunkDensity& density, int x, int y, int z) {
+		glm::ivec3 corner{x, y, z};
+		glm::ivec3 last{density.sizeX - 1, density.sizeY - 1, density.sizeZ - 1};
+		glm::vec3 gradient;
+		for (int axis = 0; axis < 3; ++axis){
+			glm::ivec3 low = corner;
+			glm::ivec3 high = corner;
+			low[axis] = std::max(corner[axis] - 1, 0);
+			high[axis] = std::min(corner[axis] + 1, last[axis]);
+			int span = std::max(high[axis] - low[axis], 1);
+			gradient[axis] = (density.get(high.x, high.y, high.z) - density.get(low.x, low.y, low.z)) / span;
+		}
+		return gradient;
+	}
+
+	// Packed outward normal from a density gradient, the face normal where the field is flat
+	static uint32_t VertexNormal(const glm::vec3& gradient, const glm::vec3& faceNormal) {
+		float length = glm::length(gradient);
+		return OctahedralNormal::Pack16(length > 1e-6f ? -gradient / length : faceNormal);
+	}
+
+private:
+
+	// Interpolated position of the iso crossing along a cube edge, relative to corner 3,
+	// and the corner gradients interpolated to the same point
+	static glm::vec3 EdgePoint(const float cornerValues[8], const glm::vec3 cornerGradients[8], int edge, float isoLevel, glm::vec3& gradient) {
+		int a = cornerIndexAFromEdge[edge];
+		int b = cornerIndexBFromEdge[edge];
+		glm::vec3 posA{cornerOffsets[a][0], cornerOffsets[a][1], cornerOffsets[a][2]};
+		glm::vec3 posB{cornerOffsets[b][0], cornerOffsets[b][1], cornerOffsets[b][2]};
+
+		float denom = cornerValues[b] - cornerValues[a];
+		float t = glm::clamp(std::abs(denom) < 1e-6f ? 0.5f : (isoLevel - cornerValues[a]) / denom, 0.0f, 1.0f);
+		gradient = glm::mix(cornerGradients[a], cornerGradients[b], t);
+		return posA + t * (posB - posA);
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,64 @@
+#ifndef NOISE_BOUNDS_H
+#define NOISE_BOUNDS_H
+
+#include "terrain_settings.h"
+#include <algorithm>
+
+namespace Engine{
+
+struct NoiseInterval{
+	float min;
+	float max;
+
+	bool below(float value) const {return max < value;}
+	bool atOrAbove(float value) const {return min >= value;}
+};
+
+// Conservative bounds on the layered noise used by the terrain.
+// Every octave is at most 1 in magnitude and changes by at most
+// perlinLipschitz per unit of its own input, so one sample bounds a whole region.
+class NoiseBounds{
+public:
+
+	// FastNoiseLite Perlin 3D measures a max gradient of ~3.2 per unit, rounded up for margin
+	static constexpr float perlinLipschitz = 4.0f;
+
+	static float AmplitudeSum(const TerrainSettings& settings) {
+		float amplitudeSum = 0.0f;
+		float amplitude = 1.0f;
+		for (int i = 0; i < settings.octaves; i++) {
+			amplitudeSum += amplitude;
+			amplitude *= settings.prominance;
+		}
+		return amplitudeSum;
+	}
+
+	// Range of GetNoise3D anywhere in the world
+	static NoiseInterval CaveNoiseRange(const TerrainSettings& settings) {
+		float amplitudeSum = AmplitudeSum(settings);
+		return {(1.0f - amplitudeSum) / 2.0f, (1.0f + amplitudeSum) / 2.0f};
+	}
+
+	// Max change of GetNoise3D per world unit, baseFrequency is the generator's own frequency
+	static float CaveNoiseLipschitz(const TerrainSettings& settings, float baseFrequency) {
+		float lipschitz = 0.0f;
+		float frequency = baseFrequency / settings.caveNoiseScale;
+		float amplitude = 1.0f;
+		for (int i = 0; i < settings.octaves; i++) {
+			lipschitz += amplitude * frequency * perlinLipschitz;
+			frequency *= 2.0f;
+			amplitude *= settings.prominance;
+		}
+		return lipschitz / 2.0f; // GetNoise3D remaps to (n + 1) / 2
+	}
+
+	// Range of GetNoise3D within radius of a point where it was sampled as value
+	static NoiseInterval CaveNoiseAround(const TerrainSettings& settings, float baseFrequency, float value, float radius) {
+		NoiseInterval range = CaveNoiseRange(settings);
+		float spread = CaveNoiseLipschitz(settings, baseFrequency) * radius;
+		return {std::max(range.min, value - spread), std::min(range.max, value + spread)};
+	}
+};
+
+} // namespace
+#endif
@@ -0,0 +1,48 @@
+#ifndef OCTAHEDRAL_H
+#define OCTAHEDRAL_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include "../vendor/glm/gtc/packing.hpp"
+#include <cstdint>
+#include <cmath>
+
+namespace Engine{
+
+// Unit normals stored as two signed components. The normal is projected onto the
+// octahedron |x| + |y| + |z| = 1 and the lower half folded over the upper one, which
+// spreads the precision evenly over the sphere unlike storing x and y alone.
+class OctahedralNormal{
+public:
+
+	// Point in [-1, 1]^2 for a unit normal
+	static glm::vec2 Encode(const glm::vec3& normal) {
+		glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+		glm::vec2 e{n.x, n.z};
+		if (n.y < 0.0f) e = (1.0f - glm::abs(glm::vec2{e.y, e.x})) * SignNotZero(e);
+		return e;
+	}
+
+	static glm::vec3 Decode(const glm::vec2& e) {
+		glm::vec3 n{e.x, 1.0f - std::abs(e.x) - std::abs(e.y), e.y};
+		if (n.y < 0.0f){
+			glm::vec2 folded = (1.0f - glm::abs(glm::vec2{n.z, n.x})) * SignNotZero({n.x, n.z});
+			n.x = folded.x;
+			n.z = folded.y;
+		}
+		return glm::normalize(n);
+	}
+
+	// Two snorm16 components, VK_FORMAT_R16G16_SNORM
+	static uint32_t Pack16(const glm::vec3& normal) {return glm::packSnorm2x16(Encode(normal));}
+	static glm::vec3 Unpack16(uint32_t packed) {return Decode(glm::unpackSnorm2x16(packed));}
+
+private:
+	static glm::vec2 SignNotZero(const glm::vec2& v) {
+		return {v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f};
+	}
+};
+
+} // namespace
+#endif
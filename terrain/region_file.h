@@ -0,0 +1,566 @@
+#ifndef REGION_FILE_H
+#define REGION_FILE_H
+
+#include "chunk_density.h"
+#include "terrain_settings.h"
+#include "marching_cubes.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+	#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+	#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#undef near
+	#undef far
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace Engine{
+
+// Read only memory mapping of a whole file
+class MappedFile{
+public:
+	MappedFile() = default;
+	~MappedFile() {close();}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path){
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {close(); return false;}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {close(); return false;}
+		bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (bytes == nullptr) {close(); return false;}
+		length = static_cast<size_t>(fileSize.QuadPart);
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {close(); return false;}
+		void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED) {close(); return false;}
+		bytes = static_cast<const unsigned char*>(address);
+		length = static_cast<size_t>(info.st_size);
+#endif
+		return true;
+	}
+
+	void close(){
+#ifdef _WIN32
+		if (bytes) UnmapViewOfFile(bytes);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	const unsigned char* data() const {return bytes;}
+	size_t size() const {return length;}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+};
+
+
+// Stores generated chunks on disk, many chunks per region file.
+//
+// Region file layout:
+//   RegionHeader
+//   RegionEntry[regionSize * regionSize]   offset table, zero length = not stored
+//   payloads                                appended, each is compressed density then the mesh vertices
+//
+// Rewriting a chunk leaves its old payload behind as dead space, once that outweighs
+// the live payloads the region is copied compacted to a new file that replaces it.
+//
+// Files live in <directory>/<settings hash>/ so a different seed or settings
+// never reads stale chunks. Reads go through a memory mapping, writes happen
+// on a background thread.
+class RegionCache{
+public:
+	static constexpr int regionSize = 16; // chunks per region edge
+	static constexpr uint32_t formatVersion = 10;
+
+	RegionCache(const std::string& directory, const TerrainSettings& settings)
+	: settingsHash(settings.hash()), chunkSize(settings.chunkSize), worldHeight(settings.worldHeight)
+	{
+		char hashName[17];
+		snprintf(hashName, sizeof(hashName), "%016llx", static_cast<unsigned long long>(settingsHash));
+		regionDirectory = (std::filesystem::path(directory) / hashName).string();
+
+		std::error_code error;
+		std::filesystem::create_directories(regionDirectory, error);
+		enabled = !error;
+
+		writerThread = std::thread([this]() {WriterLoop();});
+	}
+
+	~RegionCache(){
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopWriter = true;
+		}
+		queueCondition.notify_all();
+		if (writerThread.joinable()) writerThread.join();
+	}
+
+	RegionCache(const RegionCache&) = delete;
+	RegionCache& operator=(const RegionCache&) = delete;
+
+
+	// Chunk coordinates are in chunk units, not world units.
+	// Returns false if the chunk has never been stored.
+	bool Load(int chunkX, int chunkZ, ChunkDensity& density, std::vector<TerrainVertex>* mesh = nullptr) {
+		if (!enabled) return false;
+
+		// Chunks still waiting in the write queue
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			auto pending = pendingWrites.find(ChunkKey(chunkX, chunkZ));
+			if (pending != pendingWrites.end()){
+				density = pending->second->density;
+				if (mesh) *mesh = pending->second->mesh;
+				return true;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(fileMutex);
+		int regionX = FloorDiv(chunkX, regionSize);
+		int regionZ = FloorDiv(chunkZ, regionSize);
+		MappedFile* region = MapRegion(regionX, regionZ);
+		if (!region) return false;
+
+		const RegionEntry* table = reinterpret_cast<const RegionEntry*>(region->data() + sizeof(RegionHeader));
+		const RegionEntry& entry = table[EntryIndex(chunkX, chunkZ)];
+		if (entry.densityBytes == 0) return false;
+		if (entry.offset + entry.densityBytes + entry.meshBytes > region->size()) return false;
+
+		const unsigned char* payload = region->data() + entry.offset;
+		if (!DecompressDensity(payload, entry.densityBytes, density)) return false;
+
+		if (mesh && !DeserialiseMesh(payload + entry.densityBytes, entry.meshBytes, *mesh)) return false;
+		return true;
+	}
+
+	// Queues the chunk to be written, returns immediately
+	void Store(int chunkX, int chunkZ, const ChunkDensity& density, const std::vector<TerrainVertex>* mesh = nullptr) {
+		if (!enabled) return;
+
+		auto job = std::make_shared<WriteJob>();
+		job->chunkX = chunkX;
+		job->chunkZ = chunkZ;
+		job->density = density;
+		if (mesh) job->mesh = *mesh;
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			pendingWrites[ChunkKey(chunkX, chunkZ)] = job;
+			writeQueue.push_back(job);
+		}
+		queueCondition.notify_one();
+	}
+
+	// Blocks until every queued chunk has been written
+	void Flush() {
+		std::unique_lock<std::mutex> lock(queueMutex);
+		idleCondition.wait(lock, [this]() {return writeQueue.empty() && !writing;});
+	}
+
+	bool isEnabled() const {return enabled;}
+	const std::string& getDirectory() const {return regionDirectory;}
+
+
+// DENSITY COMPRESSION /////////////////////////////////////////////////////////////
+	// Densities are quantised to 16 bits then run length encoded in packets.
+	// Each packet starts with a uint16 header, the top bit marks a run of one repeated
+	// value, otherwise the low 15 bits count the literal values that follow.
+	// Air and solid rock collapse into a handful of runs, the surface band stays literal.
+	static void CompressDensity(const ChunkDensity& density, std::vector<unsigned char>& out) {
+		out.clear();
+		int32_t dims[3] = {density.sizeX, density.sizeY, density.sizeZ};
+		Append(out, dims, sizeof(dims));
+
+		const size_t count = density.count();
+		std::vector<uint16_t> quantised(count);
+		for (size_t i = 0; i < count; ++i) quantised[i] = Quantise(density.values[i]);
+
+		const uint16_t maxPacket = 0x7FFF;
+		size_t i = 0;
+		while (i < count){
+			size_t run = 1;
+			while (i + run < count && run < maxPacket && quantised[i + run] == quantised[i]) ++run;
+
+			if (run >= 3){
+				uint16_t header = static_cast<uint16_t>(0x8000 | run);
+				Append(out, &header, sizeof(header));
+				Append(out, &quantised[i], sizeof(uint16_t));
+				i += run;
+				continue;
+			}
+
+			// Gather literals until the next run of 3 or more
+			size_t start = i;
+			while (i < count && i - start < maxPacket){
+				if (i + 2 < count && quantised[i] == quantised[i + 1] && quantised[i] == quantised[i + 2]) break;
+				++i;
+			}
+			uint16_t header = static_cast<uint16_t>(i - start);
+			Append(out, &header, sizeof(header));
+			Append(out, &quantised[start], (i - start) * sizeof(uint16_t));
+		}
+	}
+
+	static bool DecompressDensity(const unsigned char* data, size_t size, ChunkDensity& density) {
+		if (size < sizeof(int32_t) * 3) return false;
+		int32_t dims[3];
+		std::memcpy(dims, data, sizeof(dims));
+		density = ChunkDensity(dims[0], dims[1], dims[2]);
+
+		size_t read = sizeof(dims);
+		size_t written = 0;
+		const size_t count = density.count();
+		while (read + sizeof(uint16_t) <= size && written < count){
+			uint16_t header;
+			std::memcpy(&header, data + read, sizeof(header));
+			read += sizeof(header);
+
+			size_t packetCount = header & 0x7FFF;
+			if (written + packetCount > count) return false;
+
+			if (header & 0x8000){
+				if (read + sizeof(uint16_t) > size) return false;
+				uint16_t value;
+				std::memcpy(&value, data + read, sizeof(value));
+				read += sizeof(value);
+				std::fill_n(density.values.begin() + written, packetCount, Dequantise(value));
+			}
+			else {
+				if (read + packetCount * sizeof(uint16_t) > size) return false;
+				for (size_t i = 0; i < packetCount; ++i){
+					uint16_t value;
+					std::memcpy(&value, data + read, sizeof(value));
+					read += sizeof(value);
+					density.values[written + i] = Dequantise(value);
+				}
+			}
+			written += packetCount;
+		}
+		return written == count;
+	}
+// DENSITY COMPRESSION /////////////////////////////////////////////////////////////
+
+
+// MESH SERIALISATION //////////////////////////////////////////////////////////////
+	// Each vertex is written field by field, position xyz and the packed normal then
+	// material, occlusion and light, so the in-memory padding of TerrainVertex never
+	// reaches the disk and a change to the struct cannot silently misread old files.
+	static constexpr size_t vertexBytes = sizeof(float) * 3 + sizeof(uint32_t) + 3;
+
+	static void SerialiseMesh(const std::vector<TerrainVertex>& mesh, std::vector<unsigned char>& out) {
+		out.clear();
+		out.reserve(mesh.size() * vertexBytes);
+		for (const TerrainVertex& vertex : mesh){
+			float position[3] = {vertex.position.x, vertex.position.y, vertex.position.z};
+			uint8_t bytes[3] = {static_cast<uint8_t>(vertex.material), vertex.occlusion, vertex.light};
+			Append(out, position, sizeof(position));
+			Append(out, &vertex.normal, sizeof(vertex.normal));
+			Append(out, bytes, sizeof(bytes));
+		}
+	}
+
+	static bool DeserialiseMesh(const unsigned char* data, size_t size, std::vector<TerrainVertex>& mesh) {
+		if (size % vertexBytes != 0) return false;
+		mesh.resize(size / vertexBytes);
+		for (TerrainVertex& vertex : mesh){
+			float position[3];
+			std::memcpy(position, data, sizeof(position));
+			std::memcpy(&vertex.normal, data + sizeof(position), sizeof(vertex.normal));
+			const unsigned char* bytes = data + sizeof(position) + sizeof(vertex.normal);
+			vertex.position = {position[0], position[1], position[2]};
+			vertex.material = static_cast<TerrainMaterial>(bytes[0]);
+			vertex.occlusion = bytes[1];
+			vertex.light = bytes[2];
+			data += vertexBytes;
+		}
+		return true;
+	}
+// MESH SERIALISATION //////////////////////////////////////////////////////////////
+
+private:
+
+	struct RegionHeader{
+		char magic[4];
+		uint32_t version;
+		uint64_t settingsHash;
+		int32_t chunkSize;
+		int32_t worldHeight;
+	};
+
+	struct RegionEntry{
+		uint64_t offset;
+		uint32_t densityBytes;
+		uint32_t meshBytes;
+	};
+
+	struct WriteJob{
+		int chunkX;
+		int chunkZ;
+		ChunkDensity density;
+		std::vector<TerrainVertex> mesh;
+	};
+
+	static constexpr size_t tableBytes = sizeof(RegionEntry) * regionSize * regionSize;
+	static constexpr uint64_t compactBytes = 1 << 20; // dead space a region may always carry
+
+	// Member variables
+	uint64_t settingsHash;
+	int chunkSize;
+	int worldHeight;
+	std::string regionDirectory;
+	bool enabled = false;
+
+	std::mutex fileMutex;
+	std::unordered_map<int64_t, std::unique_ptr<MappedFile>> mappedRegions;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::condition_variable idleCondition;
+	std::deque<std::shared_ptr<WriteJob>> writeQueue;
+	std::unordered_map<int64_t, std::shared_ptr<WriteJob>> pendingWrites;
+	bool writing = false;
+	bool stopWriter = false;
+	std::thread writerThread;
+
+
+	static int FloorDiv(int value, int divisor) {
+		int quotient = value / divisor;
+		if ((value % divisor != 0) && ((value < 0) != (divisor < 0))) --quotient;
+		return quotient;
+	}
+
+	static int64_t ChunkKey(int x, int z) {
+		return (static_cast<int64_t>(x) << 32) ^ static_cast<uint32_t>(z);
+	}
+
+	static int EntryIndex(int chunkX, int chunkZ) {
+		int localX = chunkX - FloorDiv(chunkX, regionSize) * regionSize;
+		int localZ = chunkZ - FloorDiv(chunkZ, regionSize) * regionSize;
+		return localX * regionSize + localZ;
+	}
+
+	static uint16_t Quantise(float value) {
+		return static_cast<uint16_t>(std::round(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	static float Dequantise(uint16_t value) {
+		return value / 65535.0f;
+	}
+
+	static void Append(std::vector<unsigned char>& out, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	std::string RegionPath(int regionX, int regionZ) const {
+		return regionDirectory + "/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".region";
+	}
+
+	bool HeaderMatches(const RegionHeader& header) const {
+		return std::memcmp(header.magic, "TRGN", 4) == 0
+			&& header.version == formatVersion
+			&& header.settingsHash == settingsHash
+			&& header.chunkSize == chunkSize
+			&& header.worldHeight == worldHeight;
+	}
+
+	// Caller holds fileMutex
+	MappedFile* MapRegion(int regionX, int regionZ) {
+		int64_t key = ChunkKey(regionX, regionZ);
+		auto found = mappedRegions.find(key);
+		if (found != mappedRegions.end()) return found->second.get();
+
+		auto region = std::make_unique<MappedFile>();
+		if (!region->open(RegionPath(regionX, regionZ))) return nullptr;
+		if (region->size() < sizeof(RegionHeader) + tableBytes) return nullptr;
+
+		RegionHeader header;
+		std::memcpy(&header, region->data(), sizeof(header));
+		if (!HeaderMatches(header)) return nullptr;
+
+		MappedFile* mapped = region.get();
+		mappedRegions[key] = std::move(region);
+		return mapped;
+	}
+
+
+// BACKGROUND WRITER ///////////////////////////////////////////////////////////////
+	void WriterLoop() {
+		std::vector<unsigned char> compressed;
+		std::vector<unsigned char> serialised;
+		while (true){
+			std::shared_ptr<WriteJob> job;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCondition.wait(lock, [this]() {return stopWriter || !writeQueue.empty();});
+				if (writeQueue.empty()) return; // stopping and drained
+				job = writeQueue.front();
+				writeQueue.pop_front();
+				writing = true;
+			}
+
+			CompressDensity(job->density, compressed);
+			SerialiseMesh(job->mesh, serialised);
+			WriteChunk(*job, compressed, serialised);
+
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				auto pending = pendingWrites.find(ChunkKey(job->chunkX, job->chunkZ));
+				if (pending != pendingWrites.end() && pending->second == job) pendingWrites.erase(pending);
+				writing = false;
+			}
+			idleCondition.notify_all();
+		}
+	}
+
+	void WriteChunk(const WriteJob& job, const std::vector<unsigned char>& compressed, const std::vector<unsigned char>& mesh) {
+		int regionX = FloorDiv(job.chunkX, regionSize);
+		int regionZ = FloorDiv(job.chunkZ, regionSize);
+		std::string path = RegionPath(regionX, regionZ);
+
+		std::lock_guard<std::mutex> lock(fileMutex);
+
+		// The mapping goes stale once the file grows, remap on the next read
+		mappedRegions.erase(ChunkKey(regionX, regionZ));
+
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		bool valid = false;
+		if (file.is_open()){
+			RegionHeader header;
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+			valid = file.good() && HeaderMatches(header);
+		}
+
+		// New or incompatible region file, start it from an empty table
+		if (!valid){
+			file.close();
+			file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) return;
+
+			RegionHeader header{};
+			std::memcpy(header.magic, "TRGN", 4);
+			header.version = formatVersion;
+			header.settingsHash = settingsHash;
+			header.chunkSize = chunkSize;
+			header.worldHeight = worldHeight;
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			std::vector<RegionEntry> emptyTable(regionSize * regionSize, RegionEntry{0, 0, 0});
+			file.write(reinterpret_cast<const char*>(emptyTable.data()), tableBytes);
+		}
+
+		// Append the payload, old payloads of rewritten chunks are left as dead space
+		file.seekp(0, std::ios::end);
+		RegionEntry entry;
+		entry.offset = static_cast<uint64_t>(file.tellp());
+		entry.densityBytes = static_cast<uint32_t>(compressed.size());
+		entry.meshBytes = static_cast<uint32_t>(mesh.size());
+		file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+		if (!mesh.empty()) file.write(reinterpret_cast<const char*>(mesh.data()), mesh.size());
+
+		// Publish the entry last so a partially written payload is never referenced
+		file.seekp(sizeof(RegionHeader) + EntryIndex(job.chunkX, job.chunkZ) * sizeof(RegionEntry));
+		file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+		file.flush();
+
+		std::vector<RegionEntry> table(regionSize * regionSize);
+		file.seekg(sizeof(RegionHeader));
+		file.read(reinterpret_cast<char*>(table.data()), tableBytes);
+		if (!file.good()) return;
+
+		uint64_t live = 0;
+		for (const RegionEntry& stored : table) live += stored.densityBytes + stored.meshBytes;
+		uint64_t dead = entry.offset + entry.densityBytes + entry.meshBytes - sizeof(RegionHeader) - tableBytes - live;
+		if (dead > compactBytes && dead > live) Compact(file, path, table);
+	}
+
+	// Copies the live payloads back to back into a new file and swaps it in, the old
+	// file stays whole until the rename so an interrupted compaction loses nothing.
+	// Caller holds fileMutex and has dropped the region's mapping.
+	void Compact(std::fstream& file, const std::string& path, std::vector<RegionEntry> table) {
+		std::string compactedPath = path + ".compact";
+		std::ofstream compacted(compactedPath, std::ios::binary | std::ios::trunc);
+		if (!compacted.is_open()) return;
+
+		RegionHeader header;
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		compacted.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		compacted.seekp(sizeof(RegionHeader) + tableBytes);
+
+		std::vector<char> payload;
+		for (RegionEntry& stored : table){
+			if (stored.densityBytes == 0) continue;
+			payload.resize(stored.densityBytes + stored.meshBytes);
+			file.seekg(stored.offset);
+			file.read(payload.data(), payload.size());
+			stored.offset = static_cast<uint64_t>(compacted.tellp());
+			compacted.write(payload.data(), payload.size());
+		}
+		compacted.seekp(sizeof(RegionHeader));
+		compacted.write(reinterpret_cast<const char*>(table.data()), tableBytes);
+
+		bool written = file.good() && compacted.good();
+		file.close();
+		compacted.close();
+
+		std::error_code error;
+		if (written) std::filesystem::rename(compactedPath, path, error);
+		if (!written || error) std::filesystem::remove(compactedPath, error);
+	}
+// BACKGROUND WRITER ///////////////////////////////////////////////////////////////
+};
+
+} // namespace
+#endif
@@ -1,3 +1,6 @@
+#ifndef TABLES_H
+#define TABLES_H
+
 // LOOKUP TABLES //////////////////////////////////////////////
 int cornerIndexAFromEdge[12] = {0,1,2,3,4,5,6,7,0,1,2,3};
 int cornerIndexBFromEdge[12] = {1,2,3,0,5,6,7,4,4,5,6,7};
@@ -259,3 +262,5 @@ int TriTable[256][16]={
 { 0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
 { 0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }};
+
+#endif
@@ -7,46 +7,41 @@
 #include "../src/engine_mesh.h"
 #include "../src/engine_device.h"
 #include "../src/engine_buffer.h"
-#include "../src/Vector.h"
+#include "../src/engine_game_object.h"
+#include "../src/terrain_model.h"
 #include "../src/compute_pipeline.h"
+#include "terrain_settings.h"
+#include "chunk_density.h"
+#include "compressed_density.h"
+#include "chunk_section.h"
+#include "noise_bounds.h"
+#include "cave_noise_grid.h"
+#include "marching_cubes.h"
+#include "dual_mesher.h"
+#include "greedy_mesher.h"
+#include "ambient_occlusion.h"
+#include "light_volume.h"
+#include "region_file.h"
+#include "horizon.h"
+#include "chunk_mesh.h"
+#include "terrain_brush.h"
+#include "octahedral.h"
+#include "worker_pool.h"
 #include "FastNoiseLite.h"
 #include <vector>
+#include <memory>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <array>
 
 namespace Engine{
 class Terrain{
 public:
 
-	struct TerrainSettings{
-		float isoLevel = 0.34f;
-
-		// World Settings
-		int worldHeight = 30;	
-		int surfaceHeight = 5;
-		int chunkSize = 10;
-
-
-		// Noise Settings
-		int seed = 31584;
-		int octaves = 3;
-		float prominance = 0.5f;
-		float caveNoiseScale = 0.2f;
-		float surfaceNoiseScale = 1.0f;
-		float surfaceNoiseStrength = 25.0f;
-
-		// Material Settings
-	    float snowMinHeightPercent = 0.9f;
-	    float snowMaxAngle = 55.0f;
-	    float grassMaxAngle = 45.0f;
-	    Vector3 snowColour;
-	    Vector3 grassColour;
-	    Vector3 stoneColour;
-
-	    TerrainSettings() {
-	        snowColour = Vector3(1.0f, 1.0f, 1.0f);
-	        grassColour = Vector3(0.45f, 0.62f, 0.2f);
-	        stoneColour = Vector3(0.3f, 0.3f, 0.3f);
-	    }
-	};
+	using TerrainSettings = Engine::TerrainSettings;
 
 	
 	// Pass to GPU
@@ -56,10 +51,121 @@ public:
 		std::vector<float> Corner2DNoise;
 	};
 
+	// Level of detail a chunk is generated at. Faces and corner columns shared with
+	// coarser chunks are conformed to the coarser lattice so the meshes meet.
+	struct ChunkLod {
+		int step = 1;	// world units between lattice corners
+		int faceSteps[4] = {1, 1, 1, 1};	// -X, +X, -Z, +Z, coarsest of this chunk and the neighbour
+		int cornerSteps[4] = {1, 1, 1, 1};	// (-X,-Z), (+X,-Z), (-X,+Z), (+X,+Z), coarsest of the 4 chunks on the column
+
+		bool conforms() const {
+			for (int i = 0; i < 4; ++i){
+				if (faceSteps[i] > step || cornerSteps[i] > step) return true;
+			}
+			return false;
+		}
+
+		bool operator==(const ChunkLod& other) const {
+			return step == other.step
+				&& std::equal(faceSteps, faceSteps + 4, other.faceSteps)
+				&& std::equal(cornerSteps, cornerSteps + 4, other.cornerSteps);
+		}
+		bool operator!=(const ChunkLod& other) const {return !(*this == other);}
+	};
+
 	struct Chunk {
 		int x;
 		int y;
 		int z;
+		std::vector<ChunkSection> sections;
+		ChunkLod lod;
+		ChunkMeshLayout mesh;
+		LightVolume light;
+		bool edited = false;
+
+		// Density at a lattice corner of the chunk, corners are lod.step world units apart.
+		// A layer shared by two sections is read from the lower one when it was sampled.
+		float GetDensity(int latticeX, int latticeY, int latticeZ) const {
+			int sectionCubes = sections[0].cubeCount();
+			int index = std::min(latticeY / sectionCubes, static_cast<int>(sections.size()) - 1);
+			if (index > 0 && latticeY == sections[index].latticeMinY && sections[index - 1].state == SectionState::Mixed) index--;
+			return sections[index].get(latticeX, latticeY, latticeZ);
+		}
+	};
+
+	struct GenerationStats {
+		size_t airSections = 0;
+		size_t solidSections = 0;
+		size_t mixedSections = 0;
+		size_t densitySamples = 0;
+		size_t boundSamples = 0;	// centre samples used to bound a block
+		size_t boundedCorners = 0;	// corners filled from a bound without sampling
+		size_t caveNoiseSamples = 0;	// GetNoise3D evaluations, coarse grid points included
+		size_t conformedChunks = 0;	// chunks that matched a seam to a coarser neighbour
+		size_t stitchTriangles = 0;	// triangles closing those seams
+	};
+
+	struct EditStats {
+		size_t chunks = 0;	// chunks whose density changed
+		size_t corners = 0;	// lattice corners rewritten
+		size_t blocks = 0;	// mesh blocks re-meshed
+		size_t verticesWritten = 0;	// vertices copied into vertex buffers
+		size_t bufferRebuilds = 0;	// chunks whose blocks outgrew their slots
+		size_t litChunks = 0;	// chunks relit around the edit
+	};
+
+	struct LightStats {
+		size_t chunks = 0;	// chunks whose light changed
+		size_t corners = 0;	// corners brightened or darkened by the flood fills
+		size_t verticesWritten = 0;	// vertices whose light was rewritten in the vertex buffers
+	};
+
+	// Lights added and removed over the resident chunks, see BenchmarkLightUpdates
+	struct LightBenchmark {
+		size_t updates = 0;
+		size_t chunks = 0;	// chunks relit over all updates
+		double msPerUpdate = 0.0;
+
+		double UpdatesPerSecond() const {return msPerUpdate > 0.0 ? 1000.0 / msPerUpdate : 0.0;}
+	};
+
+	// One mesher over the same chunks, see BenchmarkMeshers
+	struct MesherBenchmark {
+		TerrainMesher mesher = TerrainMesher::MarchingCubes;
+		size_t chunks = 0;
+		size_t triangles = 0;
+		size_t vertices = 0;	// distinct positions, what an indexed buffer would hold
+		size_t slivers = 0;	// triangles with an angle under 10 degrees, degenerate ones included
+		double msPerChunk = 0.0;
+	};
+
+	// Block faces drawn one quad each against merged, see BenchmarkGreedyMeshing
+	struct GreedyBenchmark {
+		size_t chunks = 0;
+		size_t naiveQuads = 0;
+		size_t greedyQuads = 0;
+		double naiveMsPerChunk = 0.0;
+		double greedyMsPerChunk = 0.0;
+
+		float Reduction() const {return greedyQuads == 0 ? 0.0f : static_cast<float>(naiveQuads) / greedyQuads;}
+	};
+
+	// Where a ray first meets the isosurface, see RayCastDensity
+	struct DensityHit {
+		bool hit = false;
+		glm::vec3 point{0.0f};
+		glm::vec3 normal{0.0f};	// outward, against the density gradient
+		float distance = std::numeric_limits<float>::infinity();	// in units of the ray direction
+		glm::ivec2 chunk{0};	// x and z of the chunk hit
+		size_t chunkIndex = 0;	// into chunks and chunkObjects
+		size_t cells = 0;	// lattice cells walked
+	};
+
+	// Cave noise upsampled from a coarse grid compared against full resolution
+	struct DecimationError {
+		float rmsError = 0.0f;
+		float maxError = 0.0f;
+		float flippedFraction = 0.0f;	// corners whose side of isoLevel changes
 	};
 
 
@@ -67,7 +173,142 @@ public:
 
 
 	// Public member variables
-	std::vector<EngineGameObject> chunkObjects;
+	std::vector<TerrainObject> chunkObjects;
+	TerrainObject horizonObject;
+
+	// x and z of the chunk drawn by chunkObjects[index]
+	glm::ivec2 GetChunkPosition(size_t index) const {return {chunks[index].x, chunks[index].z};}
+
+	// Object drawing the chunk at x and z, null when it is not resident. Chunk objects move
+	// around as chunks stream in and out, so hold on to the position rather than the pointer.
+	TerrainObject* FindChunkObject(const glm::ivec2& chunk) {
+		const Chunk* found = FindChunk(chunk.x, chunk.y);
+		return found ? &chunkObjects[found - chunks.data()] : nullptr;
+	}
+
+	// Generated chunks are saved to and loaded from region files under directory
+	void EnableRegionCache(const std::string& directory) {
+		regionCache = std::make_unique<RegionCache>(directory, settings);
+	}
+
+	// Resident density memory across all loaded chunks, uncompressedBytes is what full float lattices would take
+	CompressedDensity::MemoryStats GetDensityMemoryStats() const {
+		CompressedDensity::MemoryStats stats;
+		for (const Chunk& chunk : chunks){
+			for (const ChunkSection& section : chunk.sections) stats += section.density.GetMemoryStats();
+		}
+		stats.uncompressedBytes = 0;
+		for (const Chunk& chunk : chunks){
+			size_t sizeXZ = settings.chunkSize / chunk.lod.step + 1;
+			size_t sizeY = LayerCount(chunk.lod.step) + 1;
+			stats.uncompressedBytes += sizeXZ * sizeY * sizeXZ * sizeof(float);
+		}
+		return stats;
+	}
+
+	const TerrainSettings& GetSettings() const {return settings;}
+
+	const GenerationStats& GetGenerationStats() const {return generationStats;}
+
+	int GetCaveDecimation() const {return caveDecimation;}
+
+	// Compares upsampled cave noise with full resolution noise over a few blocks spread through the world
+	DecimationError MeasureCaveDecimationError(int decimation, int blockCount = 8, int blockSize = 16) {
+		DecimationError error;
+		if (decimation <= 1) return error;
+
+		double squaredSum = 0.0;
+		size_t samples = 0;
+		size_t flipped = 0;
+		CaveNoiseGrid grid;
+		for (int block = 0; block < blockCount; ++block){
+			glm::vec3 blockOrigin{block * 97.0f, (block * settings.worldHeight) / static_cast<float>(blockCount), block * -61.0f};
+			grid.Reset(glm::ivec3(0), glm::ivec3(blockSize), decimation);
+			auto sampleNoise = [&](int x, int y, int z) {return GetNoise3D(blockOrigin.x + x, blockOrigin.y + y, blockOrigin.z + z);};
+
+			for (int x = 0; x <= blockSize; ++x){
+				for (int y = 0; y <= blockSize; ++y){
+					for (int z = 0; z <= blockSize; ++z){
+						float exact = sampleNoise(x, y, z);
+						float upsampled = grid.Sample(x, y, z, sampleNoise);
+						float difference = std::abs(exact - upsampled);
+						squaredSum += difference * difference;
+						error.maxError = std::max(error.maxError, difference);
+						if ((exact < settings.isoLevel) != (upsampled < settings.isoLevel)) flipped++;
+						samples++;
+					}
+				}
+			}
+		}
+		error.rmsError = static_cast<float>(std::sqrt(squaredSum / samples));
+		error.flippedFraction = static_cast<float>(flipped) / samples;
+		return error;
+	}
+
+	// Coarsest decimation whose flipped fraction stays within tolerance
+	int ChooseCaveDecimation(float maxFlippedFraction = 0.01f) {
+		for (int decimation : {4, 2}){
+			if (MeasureCaveDecimationError(decimation).flippedFraction <= maxFlippedFraction) return decimation;
+		}
+		return 1;
+	}
+
+	// Meshes the same full detail chunks, spread through the world, with every backend.
+	// The lattices are sampled once up front and only the meshing is timed.
+	std::vector<MesherBenchmark> BenchmarkMeshers(int chunkCount = 16) {
+		std::vector<ChunkDensity> lattices = SampleBenchmarkLattices(chunkCount);
+
+		// The padded lattices hold the corners dual quads reach into, marching cubes just leaves them out
+		glm::ivec3 cellMax{settings.chunkSize, LayerCount(1), settings.chunkSize};
+		std::vector<MesherBenchmark> results;
+		for (TerrainMesher mesher : {TerrainMesher::MarchingCubes, TerrainMesher::SurfaceNets, TerrainMesher::DualContouring, TerrainMesher::Blocks}){
+			MesherBenchmark result;
+			result.mesher = mesher;
+			result.chunks = lattices.size();
+			std::vector<TerrainVertex> vertices;
+			double totalMs = 0.0;
+			for (const ChunkDensity& lattice : lattices){
+				vertices.clear();
+				auto start = std::chrono::steady_clock::now();
+				if (mesher == TerrainMesher::MarchingCubes) MarchingCubes::PolygoniseBox(lattice, settings, glm::ivec3(0), cellMax, vertices);
+				else if (mesher == TerrainMesher::Blocks) GreedyMesher::Polygonise(lattice, settings, glm::ivec3(0), cellMax, vertices);
+				else DualMesher::Polygonise(lattice, settings, mesher == TerrainMesher::DualContouring, glm::ivec3(0), cellMax, vertices);
+				totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				result.triangles += vertices.size() / 3;
+				result.vertices += DistinctPositions(vertices);
+				result.slivers += CountSlivers(vertices, 10.0f);
+			}
+			result.msPerChunk = lattices.empty() ? 0.0 : totalMs / lattices.size();
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	// Block faces of the same chunks as BenchmarkMeshers with and without merging
+	GreedyBenchmark BenchmarkGreedyMeshing(int chunkCount = 16) {
+		std::vector<ChunkDensity> lattices = SampleBenchmarkLattices(chunkCount);
+		glm::ivec3 cellMax{settings.chunkSize, LayerCount(1), settings.chunkSize};
+		GreedyBenchmark result;
+		result.chunks = lattices.size();
+		if (lattices.empty()) return result;
+
+		std::vector<TerrainVertex> vertices;
+		for (bool merge : {false, true}){
+			double totalMs = 0.0;
+			size_t quads = 0;
+			for (const ChunkDensity& lattice : lattices){
+				vertices.clear();
+				auto start = std::chrono::steady_clock::now();
+				GreedyMesher::Polygonise(lattice, settings, glm::ivec3(0), cellMax, vertices, 1.0f, merge);
+				totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				quads += vertices.size() / 6;
+			}
+			(merge ? result.greedyQuads : result.naiveQuads) = quads;
+			(merge ? result.greedyMsPerChunk : result.naiveMsPerChunk) = totalMs / lattices.size();
+		}
+		return result;
+	}
 
 	void UpdateChunks(int renderDistance, float playerX, float playerZ, EngineDevice& engineDevice) {
 
@@ -94,6 +335,8 @@ public:
 				if (generatedChunkThisFarme) break;
 
 	            bool chunkPresent = false;
+				ChunkLod lod = GetChunkLod(worldX, worldZ, CenterChunkX, CenterChunkZ);
+				int staleChunkIndex = -1;
 
 	            // Check if there is a chunk at the position
 	            for (int i = 0; i < chunks.size(); ++i) {
@@ -101,6 +344,9 @@ public:
 	            	// 1 - check if chunk exists at current iteration position
 	                if (chunks[i].x == worldX && chunks[i].z == worldZ) {
 	                    chunkPresent = true;
+
+						// The player moved across a ring, its detail or a neighbour's changed
+						if (chunks[i].lod != lod) staleChunkIndex = i;
 						break;
 	                }
 
@@ -114,27 +360,330 @@ public:
 
 	            // No chunk present? Create a new one
 	            if (!chunkPresent){
-	            	GenerateChunk(worldX, worldZ, engineDevice);
+	            	GenerateChunk(worldX, worldZ, lod, engineDevice);
 					generatedChunkThisFarme = true;
 	            }
+				else if (staleChunkIndex != -1){
+					GenerateChunk(worldX, worldZ, lod, engineDevice, staleChunkIndex);
+					generatedChunkThisFarme = true;
+				}
 	        }
 	    }
 
 		// Remove 1 Chunk per frame
 		if (markedChunkIndex != -1){
+			SaveEditedChunk(chunks[markedChunkIndex]);
 			chunks.erase(chunks.begin() + markedChunkIndex);
 			chunkObjects.erase(chunkObjects.begin() + markedChunkIndex);
 		}
 	}
 
+	// Digs or places terrain. Only the lattice corners the brush reaches are rewritten and only
+	// the mesh blocks around them re-meshed, in every chunk sharing those corners, and the new
+	// vertices go straight into the existing vertex buffers.
+	EditStats Edit(const TerrainBrush& brush, EngineDevice& engineDevice) {
+		EditStats stats;
+		glm::vec3 brushMin, brushMax;
+		brush.Bounds(brushMin, brushMax);
+
+		// Every chunk's density is rewritten before any is re-meshed, dual meshes read their neighbours' corners
+		std::vector<glm::ivec3> changedMins(chunks.size(), glm::ivec3{std::numeric_limits<int>::max()});
+		std::vector<glm::ivec3> changedMaxs(chunks.size(), glm::ivec3{std::numeric_limits<int>::lowest()});
+		glm::ivec3 worldMin{std::numeric_limits<int>::max()};
+		glm::ivec3 worldMax{std::numeric_limits<int>::lowest()};
+		for (size_t i = 0; i < chunks.size(); ++i){
+			Chunk& chunk = chunks[i];
+			LatticeFrame frame = ChunkFrame(chunk);
+			float step = static_cast<float>(chunk.lod.step);
+			int last = settings.chunkSize / chunk.lod.step;
+			int top = LayerCount(chunk.lod.step);
+
+			// Lattice corners inside the brush bounds
+			glm::ivec3 low = glm::max(glm::ivec3(glm::ceil((brushMin - frame.Origin()) / step)), glm::ivec3(0));
+			glm::ivec3 high = glm::min(glm::ivec3(glm::floor((brushMax - frame.Origin()) / step)), glm::ivec3(last, top, last));
+			if (low.x > high.x || low.y > high.y || low.z > high.z) continue;
+
+			glm::ivec3 changedMin{std::numeric_limits<int>::max()};
+			glm::ivec3 changedMax{std::numeric_limits<int>::lowest()};
+			std::vector<float> values(top + 1);
+			std::vector<uint8_t> written(top + 1);
+			for (int x = low.x; x <= high.x; ++x){
+				for (int z = low.z; z <= high.z; ++z){
+					bool columnChanged = false;
+					std::fill(written.begin(), written.end(), 0);
+					for (int y = low.y; y <= high.y; ++y){
+						float before = chunk.GetDensity(x, y, z);
+						float after = brush.Apply(frame.Corner(x, y, z), before, settings.isoLevel);
+						if (after == before) continue;
+						values[y] = after;
+						written[y] = 1;
+						columnChanged = true;
+						changedMin = glm::min(changedMin, glm::ivec3(x, y, z));
+						changedMax = glm::max(changedMax, glm::ivec3(x, y, z));
+						stats.corners++;
+					}
+					if (!columnChanged) continue;
+
+					// Shared layers are written to both sections
+					for (ChunkSection& section : chunk.sections){
+						if (std::none_of(written.begin() + section.latticeMinY, written.begin() + section.latticeMaxY + 1, [](uint8_t w) {return w != 0;})) continue;
+						section.Expand(last + 1, last + 1, settings.isoLevel, DensityPrecision());
+						section.density.SetColumn(x, z, values.data() + section.latticeMinY, written.data() + section.latticeMinY, settings.isoLevel);
+					}
+				}
+			}
+			if (changedMin.x > changedMax.x) continue;
+
+			chunk.edited = true;
+			stats.chunks++;
+			changedMins[i] = changedMin;
+			changedMaxs[i] = changedMax;
+			worldMin = glm::min(worldMin, frame.Index(changedMin.x, changedMin.y, changedMin.z));
+			worldMax = glm::max(worldMax, frame.Index(changedMax.x, changedMax.y, changedMax.z));
+		}
+		if (stats.chunks == 0) return stats;
+
+		// Corners that opened or closed let light in or cut it off, the re-meshed blocks bake the new light
+		std::vector<LightQueues> lightQueues(chunks.size());
+		for (size_t i = 0; i < chunks.size(); ++i){
+			if (changedMins[i].x <= changedMaxs[i].x) UpdateOpenCorners(i, changedMins[i], changedMaxs[i], lightQueues[i]);
+		}
+		PropagateLight(lightQueues);
+
+		// Changed corners also shift the occlusion of the vertices within occlusionRadius of them
+		int reach = settings.occlusionRadius;
+		for (size_t i = 0; i < chunks.size(); ++i){
+			const Chunk& chunk = chunks[i];
+
+			// Changed corners of the chunk and of its padding, which may belong to an unchanged chunk.
+			// Marching cubes takes them into the gradients of the corners next to them, so every cube
+			// touching one of those re-meshes.
+			// Dual meshes move the vertices of the cells around them, whose quads are owned one cell further down.
+			// A block's material depends on every block above it, so blocks re-mesh their columns to the bottom.
+			LatticeFrame frame = ChunkFrame(chunk);
+			float step = static_cast<float>(chunk.lod.step);
+			int last = settings.chunkSize / chunk.lod.step;
+			int before = PaddedMeshing() ? 0 : 1;
+			glm::ivec3 low = glm::max(glm::ivec3(glm::floor(glm::vec3(worldMin - frame.base) / step)), glm::ivec3(-before, 0, -before));
+			glm::ivec3 high = glm::min(glm::ivec3(glm::ceil(glm::vec3(worldMax - frame.base) / step)), glm::ivec3(last + 1, LayerCount(chunk.lod.step), last + 1));
+			if (low.x > high.x || low.y > high.y || low.z > high.z) continue;
+			if (!PaddedMeshing()){
+				RemeshBlocks(i, chunk.mesh.BlocksIn(low - 2 - reach, high + 1 + reach), engineDevice, stats);
+				continue;
+			}
+			if (settings.mesher == TerrainMesher::Blocks) low.y = 0;
+			RemeshBlocks(i, chunk.mesh.BlocksIn(low - 2 - reach, high + reach), engineDevice, stats);
+		}
+
+		LightStats lightStats;
+		UploadLight(lightStats);
+		stats.litChunks = lightStats.chunks;
+		return stats;
+	}
+
+	// Places a light of level 1 to 15 and floods it out from its corner.
+	// The vertices it reaches are rewritten unless upload is false.
+	LightStats AddLight(const glm::vec3& position, int level, bool upload = true) {
+		level = glm::clamp(level, 1, LightVolume::maxLevel);
+		lightSources.push_back({position, level});
+		std::vector<LightQueues> queues(chunks.size());
+		for (size_t i : ChunksIn(CornerIndex(position), CornerIndex(position))) SeedLightSource(chunks[i], lightSources.back(), queues[i].raised[1]);
+		LightStats stats = PropagateLight(queues);
+		UploadLight(stats, upload);
+		return stats;
+	}
+
+	// Takes out the lights within half a world unit of position and the light they spread,
+	// the vertices that lose it are rewritten unless upload is false
+	LightStats RemoveLight(const glm::vec3& position, bool upload = true) {
+		std::vector<LightQueues> queues(chunks.size());
+		for (size_t s = 0; s < lightSources.size();){
+			const LightSource& source = lightSources[s];
+			if (glm::length(source.position - position) > 0.5f){
+				++s;
+				continue;
+			}
+			for (size_t i : ChunksIn(CornerIndex(source.position), CornerIndex(source.position))){
+				glm::ivec3 corner = SourceCorner(chunks[i], source);
+				if (chunks[i].light.Inside(corner)) chunks[i].light.Lower(LightVolume::Block, corner, queues[i].lowered[1]);
+			}
+			lightSources.erase(lightSources.begin() + s);
+		}
+		LightStats stats = PropagateLight(queues);
+		UploadLight(stats, upload);
+		return stats;
+	}
+
+	// Adds a full strength light at points spread over the resident chunks and takes it out again,
+	// the light solves only, the vertex buffers are left alone. Each add and each removal is an update.
+	LightBenchmark BenchmarkLightUpdates(int count = 32) {
+		LightBenchmark result;
+		if (chunks.empty()) return result;
+		double totalMs = 0.0;
+		for (int i = 0; i < count; ++i){
+			LatticeFrame frame = ChunkFrame(chunks[(i * 7) % chunks.size()]);
+			glm::vec3 offset{(i * 5) % settings.chunkSize, (i * 11) % std::max(settings.worldHeight, 1), (i * 3) % settings.chunkSize};
+			glm::vec3 position = frame.Origin() + offset;
+
+			auto start = std::chrono::steady_clock::now();
+			result.chunks += AddLight(position, LightVolume::maxLevel, false).chunks;
+			result.chunks += RemoveLight(position, false).chunks;
+			totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			result.updates += 2;
+		}
+		result.msPerUpdate = totalMs / result.updates;
+		return result;
+	}
+
+	// First crossing of isoLevel along the ray through the resident chunks' density. The ray walks the
+	// world lattice a cell at a time (Amanatides and Woo), sampling where it leaves each cell, and the
+	// hit is interpolated between the two samples bracketing the surface. No mesh is involved, so it
+	// also sees chunks not uploaded yet. Cells of coarser chunks are sampled in between their corners.
+	// A ray starting inside the ground hits where it starts.
+	DensityHit RayCastDensity(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = std::numeric_limits<float>::infinity()) const {
+		DensityHit result;
+		if (chunks.empty() || direction == glm::vec3(0.0f)) return result;
+
+		// The ray in world lattice index space, where cell k spans corners k to k + 1
+		glm::vec3 start = origin + 0.5f;
+
+		// Clipped to the box of the resident lattices, columns without a chunk are walked through
+		glm::vec3 low{std::numeric_limits<float>::infinity()}, high{-std::numeric_limits<float>::infinity()};
+		for (const Chunk& chunk : chunks){
+			LatticeFrame frame = ChunkFrame(chunk);
+			low = glm::min(low, glm::vec3(frame.base));
+			high = glm::max(high, glm::vec3(frame.base + glm::ivec3(settings.chunkSize, LayerCount(frame.step) * frame.step, settings.chunkSize)));
+		}
+		float t = 0.0f, tExit = maxDistance;
+		for (int axis = 0; axis < 3; ++axis){
+			if (direction[axis] == 0.0f){
+				if (start[axis] < low[axis] || start[axis] > high[axis]) return result;
+				continue;
+			}
+			float t0 = (low[axis] - start[axis]) / direction[axis];
+			float t1 = (high[axis] - start[axis]) / direction[axis];
+			t = std::max(t, std::min(t0, t1));
+			tExit = std::min(tExit, std::max(t0, t1));
+		}
+		if (t > tExit) return result;
+
+		glm::vec3 entry = start + direction * t;
+		glm::ivec3 cell = glm::ivec3(glm::floor(entry));
+		glm::vec3 tMax{std::numeric_limits<float>::infinity()}, tDelta{std::numeric_limits<float>::infinity()};
+		for (int axis = 0; axis < 3; ++axis){
+			if (direction[axis] == 0.0f) continue;
+			float boundary = static_cast<float>(cell[axis] + (direction[axis] > 0.0f ? 1 : 0));
+			tMax[axis] = t + (boundary - entry[axis]) / direction[axis];
+			tDelta[axis] = 1.0f / std::abs(direction[axis]);
+		}
+
+		const Chunk* chunk = nullptr;
+		float previous = 0.0f;
+		bool hasPrevious = SampleWorldDensity(origin + direction * t, previous, chunk);
+		if (hasPrevious && previous >= settings.isoLevel) return DensityRayHit(origin, direction, t, chunk, result);
+		while (t < tExit){
+			int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+			float next = std::min(tMax[axis], tExit);
+			float value = 0.0f;
+			bool hasValue = SampleWorldDensity(origin + direction * next, value, chunk);
+			result.cells++;
+			if (hasValue && hasPrevious && previous < settings.isoLevel && value >= settings.isoLevel){
+				float hit = t + (settings.isoLevel - previous) / (value - previous) * (next - t);
+				return DensityRayHit(origin, direction, hit, chunk, result);
+			}
+			previous = value;
+			hasPrevious = hasValue;
+			t = next;
+			tMax[axis] += tDelta[axis];
+		}
+		return result;
+	}
+
+	// Approximate signed distance from position to the isosurface, positive in air, from the density
+	// and its gradient there. normal points into the air. False where no chunk is resident or the
+	// density is flat, which it is past about a lattice cell from the surface.
+	// chunk caches the last chunk looked up, start it at null.
+	bool SurfaceDistance(const glm::vec3& position, float& distance, glm::vec3& normal, const Chunk*& chunk) const {
+		if (chunks.empty()) return false;
+		float value;
+		glm::vec3 gradient;
+		if (!SampleWorldDensity(position, value, chunk, &gradient)) return false;
+		float slope = glm::length(gradient);
+		if (slope < 1e-4f) return false;
+		distance = (settings.isoLevel - value) / slope;
+		normal = -gradient / slope;
+		return true;
+	}
+
+	const HorizonClipmap& GetHorizon() const {return horizon;}
+
+	// Distant heightfield around the chunk range, rebuilt only when one of its levels shifts,
+	// the vertex shader morphs it by the camera every frame
+	void UpdateHorizon(int renderDistance, float playerX, float playerZ, EngineDevice& engineDevice) {
+		if (settings.horizonLevels <= 0) return;
+
+		// Same chunk range as UpdateChunks
+		int CenterChunkX = static_cast<int>(std::floor(std::round(playerX) / settings.chunkSize) * settings.chunkSize);
+		int CenterChunkZ = static_cast<int>(std::floor(std::round(playerZ) / settings.chunkSize) * settings.chunkSize);
+		int offset = (renderDistance - 1) * settings.chunkSize / 2 + (settings.chunkSize - 1) / 2;
+		glm::vec2 rangeMin{CenterChunkX - offset - 0.5f, CenterChunkZ - offset - 0.5f};
+		glm::vec2 rangeMax = rangeMin + static_cast<float>(renderDistance * settings.chunkSize);
+
+		auto surfaceHeight = [this](float x, float z) {return GetSurfaceHeight(x, z);};
+		if (!horizon.Update(settings, {playerX, playerZ}, rangeMin, rangeMax, surfaceHeight)) return;
+
+		const std::vector<TerrainVertex>& vertices = horizon.getVertices();
+		horizonObject.setTranslation(horizon.getOrigin());
+		horizonObject.model = vertices.size() >= 3 ? std::make_shared<TerrainModel>(engineDevice, vertices, horizon.getMorphTargets(), horizon.getExtent()) : nullptr;
+	}
+
 private:
-	void Init() {InitNoiseGenerator();}
+	void Init() {
+		InitNoiseGenerator();
+		caveDecimation = settings.caveNoiseDecimation == 0 ? ChooseCaveDecimation() : std::max(1, settings.caveNoiseDecimation);
+	}
+
+	// Base frequency of both generators, the noise bounds depend on it
+	static constexpr float noiseFrequency = 0.01f;
+
+	// A chunk's lattice placed on the world lattice, which sits on half integers.
+	// Corner (x,y,z) of the chunk is world lattice index base + step * (x,y,z).
+	struct LatticeFrame {
+		glm::ivec3 base{0};
+		int step = 1;
+
+		glm::ivec3 Index(int x, int y, int z) const {return base + glm::ivec3(x, y, z) * step;}
+		glm::vec3 Corner(int x, int y, int z) const {return Position(Index(x, y, z));}
+		glm::vec3 Origin() const {return Corner(0, 0, 0);}
+		static glm::vec3 Position(glm::ivec3 index) {return glm::vec3(index) - 0.5f;}
+	};
+
+	// A placed light, see AddLight
+	struct LightSource {
+		glm::vec3 position;
+		int level;
+	};
+
+	static constexpr LightVolume::Channel lightChannels[2] = {LightVolume::Sky, LightVolume::Block};
+
+	// Light waiting to spread or to be taken back in one chunk, indexed like lightChannels
+	struct LightQueues {
+		std::vector<glm::ivec3> raised[2];
+		std::vector<LightVolume::Removal> lowered[2];
+	};
 
 	// Member variables
 	TerrainSettings settings;
 	FastNoiseLite noiseGenerator3D;
 	FastNoiseLite noiseGenerator2D;
 	std::vector<Chunk> chunks;
+	std::unique_ptr<RegionCache> regionCache;
+	GenerationStats generationStats;
+	int caveDecimation = 1;
+	CaveNoiseGrid caveGrid;
+	HorizonClipmap horizon;
+	std::vector<LightSource> lightSources;
+	std::unique_ptr<WorkerPool> workers = std::make_unique<WorkerPool>();	// by pointer so Terrain stays movable
 
 	// VULKAN
     std::unique_ptr<ComputePipeline> computePipeline;
@@ -142,47 +691,114 @@ private:
     std::unique_ptr<EngineBuffer> chunkBuffer;
 	
 // TERRAIN GENERATION //////////////////////////////////////////////////////////////
-	void GenerateChunk(int posX, int posZ, EngineDevice& engineDevice) {
+	// Replaces the chunk at replaceIndex instead of adding one when it is not -1
+	void GenerateChunk(int posX, int posZ, const ChunkLod& lod, EngineDevice& engineDevice, int replaceIndex = -1) {
 
-	    int offset = (settings.chunkSize-1)/2;
+	    // Edits to the chunk being replaced are reloaded below
+	    if (replaceIndex != -1) SaveEditedChunk(chunks[replaceIndex]);
 
-	    std::vector<CubeGPU> gpuCubes;
+	    Chunk chunk{posX, 0, posZ};
+	    chunk.lod = lod;
+	    LatticeFrame frame = ChunkFrame(chunk);
+	    glm::vec3 origin = frame.Origin();
+	    ChunkDensity density;
+	    std::vector<TerrainVertex> vertices;
 
-	    for (int x = 0; x < settings.chunkSize; ++x) {
-	        for (int y = 0; y < settings.worldHeight; ++y) {
-	            for (int z = 0; z < settings.chunkSize; ++z) {
+	    // Chunk positions are multiples of chunkSize
+	    int chunkX = posX / settings.chunkSize;
+	    int chunkZ = posZ / settings.chunkSize;
 
-	                int cubeX = x - offset + posX;
-	                int cubeY = y;
-	                int cubeZ = z - offset + posZ;
+	    // Region files hold full detail chunks. Conformed seams depend on the neighbours and
+	    // edited chunks are saved without a mesh, both are meshed again from the stored density.
+	    bool cacheable = regionCache && lod.step == 1;
+	    bool cached = cacheable && regionCache->Load(chunkX, chunkZ, density, &vertices);
 
-	                CubeGPU cubeGPU;
-	                cubeGPU.position = glm::vec3(cubeX, cubeY, cubeZ); // cube position
+	    if (cached) BuildSections(chunk.sections, LayerCount(1));
+	    else SampleDensity(frame, density, chunk.sections);
 
-	                std::vector<glm::vec3> cornerPositions;
-	                cornerPositions.push_back(glm::vec3{cubeX - 0.5f, cubeY - 0.5f, cubeZ + 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX + 0.5f, cubeY - 0.5f, cubeZ + 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX + 0.5f, cubeY - 0.5f, cubeZ - 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX - 0.5f, cubeY - 0.5f, cubeZ - 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX - 0.5f, cubeY + 0.5f, cubeZ + 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX + 0.5f, cubeY + 0.5f, cubeZ + 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX + 0.5f, cubeY + 0.5f, cubeZ - 0.5f});
-	                cornerPositions.push_back(glm::vec3{cubeX - 0.5f, cubeY + 0.5f, cubeZ - 0.5f});
+	    if (lod.conforms()){
+	    	ConformSeams(frame, lod, density);
+	    	generationStats.conformedChunks++;
+	    }
+	    if (cached || lod.conforms()){
+	    	for (ChunkSection& section : chunk.sections){
+	    		section.state = ChunkSection::Classify(density, section.latticeMinY, section.latticeMaxY, settings.isoLevel);
+	    	}
+	    }
 
-	                // Corner noise
-	                for (int i=0; i<8; ++i){
-	                    cubeGPU.Corner3DNoise.push_back(GetNoise3D(cornerPositions[i].x, cornerPositions[i].y, cornerPositions[i].z));
-	                    cubeGPU.Corner2DNoise.push_back(GetNoise2D(cornerPositions[i].x, cornerPositions[i].z));
-	                }
+	    // Only the compressed mixed sections stay resident
+	    for (ChunkSection& section : chunk.sections){
+	    	section.Store(density, settings.isoLevel, DensityPrecision());
+	    	if (section.state == SectionState::Air) generationStats.airSections++;
+	    	else if (section.state == SectionState::Solid) generationStats.solidSections++;
+	    	else generationStats.mixedSections++;
+	    }
 
-	                // add to gpu cubes
-	                gpuCubes.push_back(cubeGPU);
-	            }
-	        }
+	    // Meshed from the lattice as the sections keep it, the same one RemeshBlocks reads after an edit,
+	    // so remeshed blocks and the ones around them, cached or not, share every edge crossing
+	    density = ReadLattice(chunk);
+
+	    // Laid out in per block slots so edits can rewrite parts of the buffer
+	    int cells = settings.chunkSize / lod.step;
+	    chunk.mesh.Reset(cells, LayerCount(lod.step), cells, settings.editBlockCells, chunk.sections[0].cubeCount());
+	    std::vector<std::vector<TerrainVertex>> blockVertices;
+
+	    if (!cached || lod.conforms() || vertices.empty()){
+	    	vertices.clear();
+
+	    	// Uniform sections cannot contain the surface
+	    	if (PaddedMeshing()){
+	    		// Dual and block meshers reach one corner past the +X and +Z faces
+	    		ChunkDensity padded = PadLattice(chunk, frame, density);
+
+	    		// The padding counts, the surface may only cross into the next chunk
+	    		std::vector<bool> mixed;
+	    		for (const ChunkSection& section : chunk.sections){
+	    			mixed.push_back(ChunkSection::Classify(padded, section.latticeMinY, section.latticeMaxY, settings.isoLevel) == SectionState::Mixed);
+	    		}
+
+	    		// Block by block as RemeshBlocks does, merged block faces never cross a block
+	    		LatticeOcclusion occlusion(padded, settings.isoLevel, cells, settings.occlusionRadius);
+	    		blockVertices.resize(chunk.mesh.BlockCount());
+	    		for (int b = 0; b < chunk.mesh.BlockCount(); ++b){
+	    			if (!mixed[chunk.mesh.BlockMin(b).y / chunk.sections[0].cubeCount()]) continue;
+	    			PolygonisePadded(padded, occlusion, chunk.mesh.BlockMin(b), chunk.mesh.BlockMax(b), blockVertices[b], static_cast<float>(lod.step));
+	    			vertices.insert(vertices.end(), blockVertices[b].begin(), blockVertices[b].end());
+	    		}
+	    	}
+	    	else {
+	    		// Normals on the side faces take central differences across them, as the neighbours do
+	    		ChunkDensity halo = HaloLattice(chunk, density);
+	    		for (const ChunkSection& section : chunk.sections){
+	    			if (section.state != SectionState::Mixed) continue;
+	    			PolygoniseHalo(halo, {0, section.latticeMinY, 0}, {cells, section.latticeMaxY, cells}, vertices, static_cast<float>(lod.step));
+	    		}
+	    		LatticeOcclusion(density, settings.isoLevel, cells, settings.occlusionRadius).Apply(vertices, static_cast<float>(lod.step));
+
+	    		// Seam fan vertices stay unoccluded
+	    		if (lod.conforms()) StitchSeams(frame, lod, density, vertices);
+	    	}
 	    }
+	    if (cacheable && !cached && !lod.conforms()) regionCache->Store(chunkX, chunkZ, density, &vertices);
+
+	    if (blockVertices.empty()) blockVertices = chunk.mesh.Bucket(vertices, static_cast<float>(lod.step), settings.mesher);
+	    std::vector<TerrainVertex> packed = chunk.mesh.Pack(blockVertices);
+
+	    TerrainObject chunkObject = CreateChunkObject(origin, MeshExtent(lod), packed, engineDevice);
+	    if (replaceIndex != -1){
+	    	chunks[replaceIndex] = std::move(chunk);
+	    	chunkObjects[replaceIndex] = std::move(chunkObject);
+	    }
+	    else {
+	    	chunks.push_back(std::move(chunk));
+	    	chunkObjects.push_back(std::move(chunkObject));
+	    	replaceIndex = static_cast<int>(chunks.size()) - 1;
+	    }
+
+	    RemeshSharedFaces(static_cast<size_t>(replaceIndex), cached, engineDevice);
 
-	    // create buffer
-	    createCubesBuffer(gpuCubes, engineDevice);
+	    // Its light spills into the neighbours already resident
+	    LightChunk(static_cast<size_t>(replaceIndex));
 
 	    // // Create a command buffer
 	    // VkCommandBufferAllocateInfo allocateInfo{};
@@ -213,8 +829,1118 @@ private:
 	    // // Wait for the completion of the compute operation
 	    // vkQueueWaitIdle(engineDevice.graphicsQueue());
 	}
+
+	LatticeFrame ChunkFrame(const Chunk& chunk) const {
+		int offset = (settings.chunkSize-1)/2;
+
+		// Lattice corner (0,0,0) is at world (x - offset - 0.5, -0.5, z - offset - 0.5),
+		// cube (x,y,z) spans corners (x,y,z) to (x+1,y+1,z+1)
+		return LatticeFrame{glm::ivec3{chunk.x - offset, 0, chunk.z - offset}, chunk.lod.step};
+	}
+
+	CompressedDensity::Precision DensityPrecision() const {
+		return settings.densityPrecisionBits == 8 ? CompressedDensity::Precision::Bits8 : CompressedDensity::Precision::Bits16;
+	}
+
+	// Cube layers of a chunk whose corners are step world units apart, the top layer may overhang worldHeight
+	int LayerCount(int step) const {
+		return (settings.worldHeight + step - 1) / step;
+	}
+
+	// Splits the chunk's cube layers into sections of sectionHeight cubes
+	void BuildSections(std::vector<ChunkSection>& sections, int layers) {
+		int sectionHeight = std::max(1, std::min(settings.sectionHeight, layers));
+		sections.clear();
+		for (int minY = 0; minY < layers; minY += sectionHeight){
+			ChunkSection section;
+			section.latticeMinY = minY;
+			section.latticeMaxY = std::min(minY + sectionHeight, layers);
+			sections.push_back(std::move(section));
+		}
+	}
+
+	// Samples every lattice corner of the chunk once, shared corners are not re-evaluated.
+	// Sections the heightmap proves are entirely air or solid are filled without any 3D noise.
+	// padding extends the lattice by that many corners past the +X and +Z faces.
+	void SampleDensity(const LatticeFrame& frame, ChunkDensity& density, std::vector<ChunkSection>& sections, int padding = 0) {
+		int layers = LayerCount(frame.step);
+		int sizeXZ = settings.chunkSize / frame.step + 1 + padding;
+		int sizeY = layers + 1;
+		density = ChunkDensity(sizeXZ, sizeY, sizeXZ);
+
+		// 2D pass, surface height of every column
+		std::vector<float> surfaceHeights(sizeXZ * sizeXZ);
+		float minSurface = std::numeric_limits<float>::max();
+		float maxSurface = std::numeric_limits<float>::lowest();
+		for (int x = 0; x < sizeXZ; ++x) {
+			for (int z = 0; z < sizeXZ; ++z) {
+				glm::vec3 corner = frame.Corner(x, 0, z);
+				float surfaceY = GetSurfaceHeight(corner.x, corner.z);
+				surfaceHeights[x * sizeXZ + z] = surfaceY;
+				minSurface = std::min(minSurface, surfaceY);
+				maxSurface = std::max(maxSurface, surfaceY);
+			}
+		}
+
+		// Above every column's surface the density is below isoLevel whatever the caves do.
+		// Below every surface it is solid only if the cave noise can never dip under isoLevel.
+		BuildSections(sections, layers);
+		bool cavesPossible = NoiseBounds::CaveNoiseRange(settings).min < settings.isoLevel;
+		for (ChunkSection& section : sections){
+			float bottomY = frame.Corner(0, section.latticeMinY, 0).y;
+			float topY = frame.Corner(0, section.latticeMaxY, 0).y;
+			if (bottomY > maxSurface) section.state = SectionState::Air;
+			else if (topY <= minSurface && !cavesPossible) section.state = SectionState::Solid;
+			else section.state = SectionState::Mixed;
+		}
+
+		// Fill uniform sections first so mixed sections overwrite the layers they share with real samples
+		for (const ChunkSection& section : sections){
+			if (section.state == SectionState::Mixed) continue;
+			FillBlock(density, {0, section.latticeMinY, 0}, {sizeXZ - 1, section.latticeMaxY, sizeXZ - 1}, section.state == SectionState::Air ? CompressedDensity::airValue : CompressedDensity::solidValue);
+		}
+
+		for (ChunkSection& section : sections){
+			if (section.state != SectionState::Mixed) continue;
+			glm::ivec3 sectionMin{0, section.latticeMinY, 0};
+			glm::ivec3 sectionMax{sizeXZ - 1, section.latticeMaxY, sizeXZ - 1};
+			if (UpsampleCaves(frame)) caveGrid.Reset(frame.Index(sectionMin.x, sectionMin.y, sectionMin.z), frame.Index(sectionMax.x, sectionMax.y, sectionMax.z), caveDecimation);
+			SampleBlock(frame, density, surfaceHeights, sectionMin, sectionMax);
+
+			// The heightmap range is conservative, the samples may still be uniform
+			section.state = ChunkSection::Classify(density, section.latticeMinY, section.latticeMaxY, settings.isoLevel);
+		}
+	}
+
+	// Hierarchical early-out over the inclusive lattice block [min, max].
+	// The block grown by one corner is bounded from the heightmap and a single noise
+	// sample at its centre. If the density provably stays on one side of isoLevel the
+	// block is filled without sampling, the margin keeps filled corners off every crossing edge.
+	void SampleBlock(const LatticeFrame& frame, ChunkDensity& density, const std::vector<float>& surfaceHeights, glm::ivec3 min, glm::ivec3 max) {
+		glm::ivec3 size = max - min + 1;
+
+		// Small enough that bounding costs as much as sampling
+		if (size.x * size.y * size.z <= 8){
+			for (int x = min.x; x <= max.x; ++x) {
+				for (int z = min.z; z <= max.z; ++z) {
+					float surfaceY = surfaceHeights[x * density.sizeZ + z];
+					for (int y = min.y; y <= max.y; ++y) {
+						density.set(x, y, z, CombineDensity(frame.Corner(x, y, z).y, surfaceY, CaveNoise(frame, x, y, z)));
+					}
+				}
+			}
+			generationStats.densitySamples += static_cast<size_t>(size.x) * size.y * size.z;
+			return;
+		}
+
+		// Surface term from the exact column heights around the block
+		float minSurface = std::numeric_limits<float>::max();
+		float maxSurface = std::numeric_limits<float>::lowest();
+		for (int x = std::max(min.x - 1, 0); x <= std::min(max.x + 1, density.sizeX - 1); ++x) {
+			for (int z = std::max(min.z - 1, 0); z <= std::min(max.z + 1, density.sizeZ - 1); ++z) {
+				float surfaceY = surfaceHeights[x * density.sizeZ + z];
+				minSurface = std::min(minSurface, surfaceY);
+				maxSurface = std::max(maxSurface, surfaceY);
+			}
+		}
+		float bottomY = frame.Corner(0, min.y - 1, 0).y;
+		float topY = frame.Corner(0, max.y + 1, 0).y;
+		float surfaceDensityMin = settings.isoLevel + (minSurface - topY);
+		float surfaceDensityMax = settings.isoLevel + (maxSurface - bottomY);
+
+		if (surfaceDensityMax < settings.isoLevel){
+			FillBlock(density, min, max, CompressedDensity::airValue);
+			generationStats.boundedCorners += static_cast<size_t>(size.x) * size.y * size.z;
+			return;
+		}
+
+		// Cave term from one sample, spread by the noise's Lipschitz bound.
+		// Upsampled noise mixes coarse points further away, which widens the radius.
+		glm::vec3 centre = frame.Origin() + glm::vec3(min + max) * (0.5f * frame.step);
+		glm::vec3 halfExtent = (glm::vec3(max - min) * 0.5f + 1.0f) * static_cast<float>(frame.step);
+		float radius = glm::length(halfExtent) + (UpsampleCaves(frame) ? CaveNoiseGrid::InterpolationRadius(caveDecimation) : 0.0f);
+		NoiseInterval cave = NoiseBounds::CaveNoiseAround(settings, noiseFrequency, GetNoise3D(centre.x, centre.y, centre.z), radius);
+		generationStats.boundSamples++;
+		generationStats.caveNoiseSamples++;
+
+		float densityMin = std::min(surfaceDensityMin, cave.min);
+		float densityMax = std::min(surfaceDensityMax, cave.max);
+		if (densityMax < settings.isoLevel || densityMin >= settings.isoLevel){
+			FillBlock(density, min, max, densityMax < settings.isoLevel ? CompressedDensity::airValue : CompressedDensity::solidValue);
+			generationStats.boundedCorners += static_cast<size_t>(size.x) * size.y * size.z;
+			return;
+		}
+
+		// Inconclusive, split every axis longer than 2 corners and recurse
+		glm::ivec3 mid = min + (max - min) / 2;
+		for (int cx = 0; cx < (size.x > 2 ? 2 : 1); ++cx) {
+			for (int cy = 0; cy < (size.y > 2 ? 2 : 1); ++cy) {
+				for (int cz = 0; cz < (size.z > 2 ? 2 : 1); ++cz) {
+					glm::ivec3 childMin{
+						size.x > 2 && cx ? mid.x + 1 : min.x,
+						size.y > 2 && cy ? mid.y + 1 : min.y,
+						size.z > 2 && cz ? mid.z + 1 : min.z};
+					glm::ivec3 childMax{
+						size.x > 2 && !cx ? mid.x : max.x,
+						size.y > 2 && !cy ? mid.y : max.y,
+						size.z > 2 && !cz ? mid.z : max.z};
+					SampleBlock(frame, density, surfaceHeights, childMin, childMax);
+				}
+			}
+		}
+	}
+
+	static void FillBlock(ChunkDensity& density, glm::ivec3 min, glm::ivec3 max, float value) {
+		for (int x = min.x; x <= max.x; ++x)
+			for (int y = min.y; y <= max.y; ++y)
+				for (int z = min.z; z <= max.z; ++z)
+					density.set(x, y, z, value);
+	}
+
+	bool DualMeshing() const {return settings.mesher == TerrainMesher::SurfaceNets || settings.mesher == TerrainMesher::DualContouring;}
+
+	// Meshers whose output reaches past the chunk's +X and +Z faces, see PadLattice
+	bool PaddedMeshing() const {return settings.mesher != TerrainMesher::MarchingCubes;}
+
+	// Dual or block mesh of the cells [cellMin, cellMax) of a padded lattice, occlusion is baked from the same lattice
+	void PolygonisePadded(const ChunkDensity& padded, const LatticeOcclusion& occlusion, const glm::ivec3& cellMin, const glm::ivec3& cellMax, std::vector<TerrainVertex>& vertices, float step) const {
+		// Merged block faces have to agree on their occlusion, the mesher bakes it itself
+		if (settings.mesher == TerrainMesher::Blocks){
+			GreedyMesher::Polygonise(padded, settings, cellMin, cellMax, vertices, step, true, occlusion.enabled() ? &occlusion : nullptr);
+			return;
+		}
+		size_t first = vertices.size();
+		DualMesher::Polygonise(padded, settings, settings.mesher == TerrainMesher::DualContouring, cellMin, cellMax, vertices, step);
+		occlusion.Apply(vertices, step, first);
+	}
+
+	// Marching cubes of the chunk's cells [cellMin, cellMax) from its lattice grown by a corner on every side face,
+	// see HaloLattice. The gradients on the faces read the corners past them, so both chunks sharing a face agree.
+	void PolygoniseHalo(const ChunkDensity& halo, const glm::ivec3& cellMin, const glm::ivec3& cellMax, std::vector<TerrainVertex>& vertices, float step) const {
+		size_t first = vertices.size();
+		MarchingCubes::PolygoniseBox(halo, settings, cellMin + glm::ivec3(1, 0, 1), cellMax + glm::ivec3(1, 0, 1), vertices, step);
+		for (size_t v = first; v < vertices.size(); ++v) vertices[v].position -= glm::vec3(step, 0.0f, step);
+	}
+
+	// Marching cubes normals on a side face read the corners past it, extrapolated while the chunk there
+	// was missing, so once it is resident the cubes along both sides of their shared face re-mesh from the
+	// lattices as kept. A chunk meshed just now already read them, one from the cache did not.
+	// Shared columns belong to the chunk towards -X and -Z, so the chunk towards +X+Z of another
+	// never reaches the corners the other's normals read.
+	void RemeshSharedFaces(size_t chunkIndex, bool cached, EngineDevice& engineDevice) {
+		if (PaddedMeshing() || chunks[chunkIndex].lod.conforms()) return;
+		EditStats stats;
+		std::vector<int> ownBlocks;
+		for (int sideX = -1; sideX <= 1; ++sideX){
+			for (int sideZ = -1; sideZ <= 1; ++sideZ){
+				glm::ivec2 side{sideX, sideZ};
+				if (side == glm::ivec2(0)) continue;
+				const Chunk& chunk = chunks[chunkIndex];
+				const Chunk* neighbour = Neighbour(chunk, side);
+				if (!neighbour || neighbour->lod.conforms()) continue;
+				if (side != glm::ivec2(-1)) RemeshBlocks(static_cast<size_t>(neighbour - chunks.data()), FaceBlocks(*neighbour, -side), engineDevice, stats);
+				if (!cached || side == glm::ivec2(1)) continue;
+				std::vector<int> face = FaceBlocks(chunk, side);
+				for (int block : face) if (std::find(ownBlocks.begin(), ownBlocks.end(), block) == ownBlocks.end()) ownBlocks.push_back(block);
+			}
+		}
+		if (!ownBlocks.empty()) RemeshBlocks(chunkIndex, ownBlocks, engineDevice, stats);
+	}
+
+	// Blocks holding the two cube layers along a side face or edge of the chunk, side points out of it
+	std::vector<int> FaceBlocks(const Chunk& chunk, const glm::ivec2& side) const {
+		int last = settings.chunkSize / chunk.lod.step - 1;
+		glm::ivec3 low{0};
+		glm::ivec3 high{last, LayerCount(chunk.lod.step) - 1, last};
+		if (side.x != 0) low.x = (high.x = side.x > 0 ? last : 1) - 1;
+		if (side.y != 0) low.z = (high.z = side.y > 0 ? last : 1) - 1;
+		return chunk.mesh.BlocksIn(low, high);
+	}
+
+	// Resident chunk at a chunk position, null when it is not loaded
+	const Chunk* FindChunk(int x, int z) const {
+		for (const Chunk& chunk : chunks){
+			if (chunk.x == x && chunk.z == z) return &chunk;
+		}
+		return nullptr;
+	}
+
+	// The chunk's lattice grown by one corner past its +X and +Z faces, what the dual and block
+	// meshers need to close the surface against the next chunks. The extra corners are read from those chunks
+	// when they are resident at the same detail and sampled as SampleDensity would otherwise.
+	ChunkDensity PadLattice(const Chunk& chunk, const LatticeFrame& frame, const ChunkDensity& density) {
+		int last = density.sizeX - 1;
+		int top = density.sizeY - 1;
+		ChunkDensity padded(density.sizeX + 1, density.sizeY, density.sizeZ + 1);
+		for (int x = 0; x <= last; ++x)
+			for (int y = 0; y <= top; ++y)
+				for (int z = 0; z <= last; ++z)
+					padded.set(x, y, z, density.get(x, y, z));
+
+		// Past the +X face, past the +Z face and the column past both
+		const glm::ivec2 sides[3] = {{1, 0}, {0, 1}, {1, 1}};
+		for (const glm::ivec2& side : sides){
+			glm::ivec2 low{side.x ? last + 1 : 0, side.y ? last + 1 : 0};
+			glm::ivec2 high{last + side.x, last + side.y};
+			const Chunk* neighbour = FindChunk(chunk.x + side.x * settings.chunkSize, chunk.z + side.y * settings.chunkSize);
+			if (neighbour && neighbour->lod.step == chunk.lod.step){
+				for (int x = low.x; x <= high.x; ++x)
+					for (int y = 0; y <= top; ++y)
+						for (int z = low.y; z <= high.y; ++z)
+							padded.set(x, y, z, neighbour->GetDensity(x - side.x * last, y, z - side.y * last));
+				continue;
+			}
+
+			if (UpsampleCaves(frame)) caveGrid.Reset(frame.Index(low.x, 0, low.y), frame.Index(high.x, top, high.y), caveDecimation);
+			for (int x = low.x; x <= high.x; ++x){
+				for (int z = low.y; z <= high.y; ++z){
+					glm::vec3 column = frame.Corner(x, 0, z);
+					float surfaceY = GetSurfaceHeight(column.x, column.z);
+					for (int y = 0; y <= top; ++y){
+						// Far enough above the surface the density clamps to air whatever the caves do
+						float cornerY = frame.Corner(x, y, z).y;
+						bool air = cornerY > surfaceY + settings.isoLevel;
+						float value = air ? CompressedDensity::airValue : CombineDensity(cornerY, surfaceY, CaveNoise(frame, x, y, z));
+						padded.set(x, y, z, QuantiseDensity(value));
+						if (!air) generationStats.densitySamples++;
+					}
+				}
+			}
+		}
+		return padded;
+	}
+
+	// The chunk's lattice grown by one corner on every side face, the corners past them marching cubes
+	// takes the gradients on its faces from. Chunks generate the corners of a shared face separately and
+	// may keep them differently, filled from a bound or sampled, so every column is read from the
+	// resident chunk furthest towards -X and then -Z that holds it, and chunks sharing a face take the
+	// same gradients on it. Columns past a face with no chunk at the same detail are extrapolated, the
+	// one sided difference, until RemeshSharedFaces re-meshes the face once one is resident.
+	ChunkDensity HaloLattice(const Chunk& chunk, const ChunkDensity& density) const {
+		int last = density.sizeX - 1;
+		int top = density.sizeY - 1;
+		const Chunk* around[3][3];	// [side x + 1][side z + 1], this chunk in the middle
+		for (int sideX = -1; sideX <= 1; ++sideX)
+			for (int sideZ = -1; sideZ <= 1; ++sideZ)
+				around[sideX + 1][sideZ + 1] = sideX == 0 && sideZ == 0 ? &chunk : Neighbour(chunk, {sideX, sideZ});
+
+		ChunkDensity halo(last + 3, top + 1, last + 3);
+		for (int haloX = -1; haloX <= last + 1; ++haloX){
+			for (int haloZ = -1; haloZ <= last + 1; ++haloZ){
+				glm::ivec2 side{haloX < 0 ? -1 : haloX > last ? 1 : 0, haloZ < 0 ? -1 : haloZ > last ? 1 : 0};
+				if (!around[side.x + 1][side.y + 1]){
+					glm::ivec2 inside = glm::clamp(glm::ivec2(haloX, haloZ), 0, last);
+					glm::ivec2 mirror = glm::clamp(2 * inside - glm::ivec2(haloX, haloZ), 0, last);
+					for (int y = 0; y <= top; ++y) halo.set(haloX + 1, y, haloZ + 1, 2.0f * density.get(inside.x, y, inside.y) - density.get(mirror.x, y, mirror.y));
+					continue;
+				}
+
+				// A column on a face or edge belongs to every chunk around it, walk to the lowest
+				glm::ivec2 owner = side;
+				int x = haloX - side.x * last;
+				int z = haloZ - side.y * last;
+				while (true){
+					if (x == 0 && owner.x > -1 && around[owner.x][owner.y + 1]) {owner.x--; x = last;}
+					else if (z == 0 && owner.y > -1 && around[owner.x + 1][owner.y]) {owner.y--; z = last;}
+					else break;
+				}
+				for (int y = 0; y <= top; ++y){
+					float value = owner == glm::ivec2(0) ? density.get(x, y, z) : around[owner.x + 1][owner.y + 1]->GetDensity(x, y, z);
+					halo.set(haloX + 1, y, haloZ + 1, value);
+				}
+			}
+		}
+		return halo;
+	}
+
+	// Resident chunk next to this one at the same detail, side in chunks, null when there is none
+	const Chunk* Neighbour(const Chunk& chunk, const glm::ivec2& side) const {
+		const Chunk* neighbour = FindChunk(chunk.x + side.x * settings.chunkSize, chunk.z + side.y * settings.chunkSize);
+		return neighbour && neighbour->lod.step == chunk.lod.step ? neighbour : nullptr;
+	}
+
+	TerrainObject CreateChunkObject(const glm::vec3& origin, const glm::vec3& extent, const std::vector<TerrainVertex>& vertices, EngineDevice& engineDevice) {
+		TerrainObject chunkObject;
+		chunkObject.setTranslation(origin);
+
+		// Chunks entirely above or below the surface have no mesh
+		if (vertices.size() >= 3){
+			chunkObject.model = std::make_shared<TerrainModel>(engineDevice, vertices, extent);
+		}
+		return chunkObject;
+	}
+
+	// Box every chunk mesh vertex lies in, the range its positions are quantised over.
+	// Dual meshes have vertices in the cells past the +X and +Z faces.
+	glm::vec3 MeshExtent(const ChunkLod& lod) const {
+		int cells = settings.chunkSize / lod.step + (DualMeshing() ? 1 : 0);
+		return glm::vec3(cells, LayerCount(lod.step), cells) * static_cast<float>(lod.step);
+	}
+
+	// Full detail chunk lattices spread through the world, padded for every mesher
+	std::vector<ChunkDensity> SampleBenchmarkLattices(int chunkCount) {
+		GenerationStats savedStats = generationStats;
+		std::vector<ChunkDensity> lattices(std::max(chunkCount, 0));
+		for (int i = 0; i < chunkCount; ++i){
+			Chunk chunk{(i * 7 - chunkCount) * settings.chunkSize, 0, (i * 3 - chunkCount) * settings.chunkSize};
+			std::vector<ChunkSection> sections;
+			SampleDensity(ChunkFrame(chunk), lattices[i], sections, 1);
+		}
+		generationStats = savedStats;
+		return lattices;
+	}
+
+	// Mesh positions with the same rounding to a 1/1024 grid
+	static size_t DistinctPositions(const std::vector<TerrainVertex>& vertices) {
+		std::vector<glm::ivec3> positions(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i) positions[i] = glm::ivec3(glm::round(vertices[i].position * 1024.0f));
+		auto less = [](const glm::ivec3& a, const glm::ivec3& b) {return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;};
+		std::sort(positions.begin(), positions.end(), less);
+		return static_cast<size_t>(std::unique(positions.begin(), positions.end()) - positions.begin());
+	}
+
+	// Triangles with an angle below minAngle degrees
+	static size_t CountSlivers(const std::vector<TerrainVertex>& vertices, float minAngle) {
+		float maxCosine = std::cos(glm::radians(minAngle));
+		size_t slivers = 0;
+		for (size_t i = 0; i + 2 < vertices.size(); i += 3){
+			glm::vec3 corners[3] = {vertices[i].position, vertices[i + 1].position, vertices[i + 2].position};
+			bool sliver = false;
+			for (int k = 0; k < 3 && !sliver; ++k){
+				glm::vec3 toB = corners[(k + 1) % 3] - corners[k];
+				glm::vec3 toC = corners[(k + 2) % 3] - corners[k];
+				float lengths = glm::length(toB) * glm::length(toC);
+				sliver = lengths <= 1e-12f || glm::dot(toB, toC) / lengths > maxCosine;
+			}
+			if (sliver) slivers++;
+		}
+		return slivers;
+	}
 // TERRAIN GENERATION //////////////////////////////////////////////////////////////
 
+// TERRAIN EDITING ////////////////////////////////////////////////////////////////
+	// Re-meshes whole blocks from the resident density and writes them into their slots,
+	// the buffer is only packed again when a block outgrew its slot
+	void RemeshBlocks(size_t chunkIndex, const std::vector<int>& blocks, EngineDevice& engineDevice, EditStats& stats) {
+		Chunk& chunk = chunks[chunkIndex];
+		TerrainObject& chunkObject = chunkObjects[chunkIndex];
+		LatticeFrame frame = ChunkFrame(chunk);
+		float step = static_cast<float>(chunk.lod.step);
+
+		int last = settings.chunkSize / chunk.lod.step;
+		std::vector<std::vector<TerrainVertex>> remeshed(blocks.size());
+
+		// Dual quads and block faces reach one cell past their block and past the chunk, marching cubes
+		// normals one corner past it on every side. Occlusion boxes reach past the blocks, it is baked
+		// from the whole lattice.
+		ChunkDensity whole, halo;
+		if (PaddedMeshing()) whole = PadLattice(chunk, frame, ReadLattice(chunk));
+		else {
+			whole = ReadLattice(chunk);
+			halo = HaloLattice(chunk, whole);
+		}
+		LatticeOcclusion occlusion(whole, settings.isoLevel, last, settings.occlusionRadius);
+
+		for (size_t b = 0; b < blocks.size(); ++b){
+			glm::ivec3 cellMin = chunk.mesh.BlockMin(blocks[b]);
+			glm::ivec3 cellMax = chunk.mesh.BlockMax(blocks[b]);
+			stats.blocks++;
+			if (PaddedMeshing()){
+				PolygonisePadded(whole, occlusion, cellMin, cellMax, remeshed[b], step);
+				continue;
+			}
+			PolygoniseHalo(halo, cellMin, cellMax, remeshed[b], step);
+			occlusion.Apply(remeshed[b], step);
+		}
+		for (std::vector<TerrainVertex>& vertices : remeshed) BakeLight(chunk, vertices);
+
+		bool fits = chunkObject.model != nullptr;
+		for (size_t b = 0; b < blocks.size() && fits; ++b){
+			fits = remeshed[b].size() <= chunk.mesh.getSlot(blocks[b]).capacity;
+		}
+		if (fits){
+			TerrainModel& model = *chunkObject.model;
+			for (size_t b = 0; b < blocks.size(); ++b){
+				chunk.mesh.FillSlot(blocks[b], remeshed[b]);
+				model.writeVertices(chunk.mesh.getSlot(blocks[b]).first, remeshed[b]);
+				stats.verticesWritten += remeshed[b].size();
+			}
+			return;
+		}
+
+		std::vector<std::vector<TerrainVertex>> blockVertices(chunk.mesh.BlockCount());
+		if (chunkObject.model) blockVertices = chunk.mesh.Unpack(chunkObject.model->readVertices());
+		for (size_t b = 0; b < blocks.size(); ++b) blockVertices[blocks[b]] = std::move(remeshed[b]);
+		std::vector<TerrainVertex> packed = chunk.mesh.Pack(blockVertices);
+		chunkObject.model = packed.size() >= 3 ? std::make_shared<TerrainModel>(engineDevice, packed, MeshExtent(chunk.lod)) : nullptr;
+		stats.verticesWritten += packed.size();
+		stats.bufferRebuilds++;
+	}
+
+	// Edited full detail chunks are written back so the edits survive unloading.
+	// No mesh is stored, the chunk is meshed again from the density when it loads.
+	void SaveEditedChunk(const Chunk& chunk) {
+		if (!regionCache || !chunk.edited || chunk.lod.step != 1) return;
+		regionCache->Store(chunk.x / settings.chunkSize, chunk.z / settings.chunkSize, ReadLattice(chunk));
+	}
+
+	// The chunk's whole lattice out of its sections
+	ChunkDensity ReadLattice(const Chunk& chunk) const {
+		int size = settings.chunkSize / chunk.lod.step + 1;
+		ChunkDensity density(size, LayerCount(chunk.lod.step) + 1, size);
+		for (int x = 0; x < density.sizeX; ++x)
+			for (int y = 0; y < density.sizeY; ++y)
+				for (int z = 0; z < density.sizeZ; ++z)
+					density.set(x, y, z, chunk.GetDensity(x, y, z));
+		return density;
+	}
+// TERRAIN EDITING ////////////////////////////////////////////////////////////////
+
+// LIGHTING ///////////////////////////////////////////////////////////////////////
+
+	// Lights a chunk just generated from scratch, its sky from the columns open to the top of the
+	// world and its block light from the light sources, and floods it into the resident neighbours
+	// and theirs into it
+	LightStats LightChunk(size_t chunkIndex) {
+		std::vector<LightQueues> queues(chunks.size());
+		Chunk& chunk = chunks[chunkIndex];
+		chunk.light.Reset(ReadLattice(chunk), settings.isoLevel);
+		chunk.light.SeedSky(queues[chunkIndex].raised[0]);
+		SeedLightSources(chunk, queues[chunkIndex].raised[1]);
+		ExchangeFaces(chunkIndex, queues);
+		LightStats stats = PropagateLight(queues);
+		UploadLight(stats);
+		return stats;
+	}
+
+	// Carries the queued changes through the chunks until the light settles, only the corners whose
+	// light changes are visited. Removals go first, then the light they uncovered and the light
+	// sources of the darkened chunks flood back in. Each pass floods the chunks with work on the
+	// worker pool, then hands the corners changed on their side faces to the same step neighbours
+	// sharing them, which may pass them on. Chunks of other steps do not exchange light.
+	LightStats PropagateLight(std::vector<LightQueues>& queues) {
+		LightStats stats;
+		std::vector<size_t> corners(chunks.size(), 0);
+		std::vector<uint8_t> darkened(chunks.size(), 0);
+		std::vector<std::array<std::vector<LightVolume::Removal>, 2>> lowSides(chunks.size());
+		std::vector<std::array<std::vector<glm::ivec3>, 2>> raisedSides(chunks.size());
+
+		while (true){
+			std::vector<size_t> active;
+			for (size_t i = 0; i < chunks.size(); ++i){
+				if (!queues[i].lowered[0].empty() || !queues[i].lowered[1].empty()) active.push_back(i);
+			}
+			if (active.empty()) break;
+			workers->ParallelFor(active.size(), [&](size_t a) {
+				size_t i = active[a];
+				darkened[i] = 1;
+				for (int c = 0; c < 2; ++c) corners[i] += chunks[i].light.Unflood(lightChannels[c], queues[i].lowered[c], queues[i].raised[c], &lowSides[i][c]);
+			});
+
+			// A shared corner is as bright on both sides, the neighbour's copy goes dark with it
+			for (size_t i : active){
+				std::array<const Chunk*, 4> neighbours = SideNeighbours(chunks[i]);
+				for (int c = 0; c < 2; ++c){
+					for (const LightVolume::Removal& removal : lowSides[i][c]){
+						ForSharedCorners(chunks[i], removal.corner, neighbours, [&](size_t n, const glm::ivec3& shared) {
+							int level = chunks[n].light.Get(lightChannels[c], shared);
+							if (level > removal.level) queues[n].raised[c].push_back(shared);
+							else chunks[n].light.Lower(lightChannels[c], shared, queues[n].lowered[c]);
+						});
+					}
+					lowSides[i][c].clear();
+				}
+			}
+		}
+
+		// Sources inside the darkened corners light them again
+		for (size_t i = 0; i < chunks.size(); ++i){
+			if (darkened[i]) SeedLightSources(chunks[i], queues[i].raised[1]);
+		}
+
+		while (true){
+			std::vector<size_t> active;
+			for (size_t i = 0; i < chunks.size(); ++i){
+				if (!queues[i].raised[0].empty() || !queues[i].raised[1].empty()) active.push_back(i);
+			}
+			if (active.empty()) break;
+			workers->ParallelFor(active.size(), [&](size_t a) {
+				size_t i = active[a];
+				for (int c = 0; c < 2; ++c) corners[i] += chunks[i].light.Flood(lightChannels[c], chunks[i].lod.step, queues[i].raised[c], &raisedSides[i][c]);
+			});
+
+			// Raising a copy already as bright does nothing, so the exchange stops at the next pass
+			for (size_t i : active){
+				std::array<const Chunk*, 4> neighbours = SideNeighbours(chunks[i]);
+				for (int c = 0; c < 2; ++c){
+					for (const glm::ivec3& corner : raisedSides[i][c]){
+						int level = chunks[i].light.Get(lightChannels[c], corner);
+						ForSharedCorners(chunks[i], corner, neighbours, [&](size_t n, const glm::ivec3& shared) {
+							chunks[n].light.Raise(lightChannels[c], shared, level, queues[n].raised[c]);
+						});
+					}
+					raisedSides[i][c].clear();
+				}
+			}
+		}
+		for (size_t count : corners) stats.corners += count;
+		return stats;
+	}
+
+	// Rewrites the light of the vertices around the corners changed since the last upload, slot by
+	// slot from each model's CPU copy. Vertices by a side face read the light across it, so changes
+	// next to a face rewrite the neighbour's vertices along it too. With upload false the changes are
+	// only counted and forgotten.
+	void UploadLight(LightStats& stats, bool upload = true) {
+		glm::ivec3 none{std::numeric_limits<int>::max()};
+		std::vector<glm::ivec3> lows(chunks.size(), none);
+		std::vector<glm::ivec3> highs(chunks.size(), -none);
+		static const glm::ivec2 sides[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+		for (size_t i = 0; i < chunks.size(); ++i){
+			glm::ivec3 low, high;
+			if (!chunks[i].light.TakeTouched(low, high)) continue;
+			stats.chunks++;
+			lows[i] = glm::min(lows[i], low);
+			highs[i] = glm::max(highs[i], high);
+			if (!upload) continue;
+
+			int last = settings.chunkSize / chunks[i].lod.step;
+			std::array<const Chunk*, 4> neighbours = SideNeighbours(chunks[i]);
+			for (int s = 0; s < 4; ++s){
+				if (!neighbours[s]) continue;
+				int axis = sides[s].x != 0 ? 0 : 2;
+				int shift = -(sides[s].x + sides[s].y) * last;
+				if (high[axis] + shift < -1 || low[axis] + shift > last + 1) continue;
+				glm::ivec3 mappedLow = low, mappedHigh = high;
+				mappedLow[axis] = glm::clamp(low[axis] + shift, 0, last);
+				mappedHigh[axis] = glm::clamp(high[axis] + shift, 0, last);
+				size_t n = static_cast<size_t>(neighbours[s] - chunks.data());
+				lows[n] = glm::min(lows[n], mappedLow);
+				highs[n] = glm::max(highs[n], mappedHigh);
+			}
+		}
+
+		// A vertex reads the corners within a cell and a half of it
+		for (size_t i = 0; upload && i < chunks.size(); ++i){
+			if (lows[i].x > highs[i].x || !chunkObjects[i].model) continue;
+			TerrainModel& model = *chunkObjects[i].model;
+			for (int block : chunks[i].mesh.BlocksIn(lows[i] - 2, highs[i] + 2)){
+				const ChunkMeshLayout::Slot& slot = chunks[i].mesh.getSlot(block);
+				if (slot.count == 0) continue;
+				std::vector<TerrainVertex> vertices = model.readVertices(slot.first, slot.count);
+				BakeLight(chunks[i], vertices);
+				model.writeLight(slot.first, vertices);
+				stats.verticesWritten += vertices.size();
+			}
+		}
+	}
+
+	// Opens or closes the corners in [low, high] whose density crossed isoLevel. Closed corners lose
+	// their light, opened ones are lit again from their open neighbours and from the sky above.
+	void UpdateOpenCorners(size_t chunkIndex, const glm::ivec3& low, const glm::ivec3& high, LightQueues& queues) {
+		static const glm::ivec3 neighbours[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+		Chunk& chunk = chunks[chunkIndex];
+		if (chunk.light.empty()) return;
+		int top = chunk.light.Size().y - 1;
+		for (int x = low.x; x <= high.x; ++x){
+			for (int y = low.y; y <= high.y; ++y){
+				for (int z = low.z; z <= high.z; ++z){
+					glm::ivec3 corner{x, y, z};
+					bool open = chunk.GetDensity(x, y, z) < settings.isoLevel;
+					if (open == chunk.light.Open(corner)) continue;
+					chunk.light.SetOpen(corner, open);
+					for (int c = 0; c < 2; ++c){
+						if (!open){
+							chunk.light.Lower(lightChannels[c], corner, queues.lowered[c]);
+							continue;
+						}
+						for (const glm::ivec3& offset : neighbours){
+							glm::ivec3 next = corner + offset;
+							if (chunk.light.Inside(next) && chunk.light.Get(lightChannels[c], next) > 0) queues.raised[c].push_back(next);
+						}
+					}
+					if (open && y == top) chunk.light.Raise(LightVolume::Sky, corner, LightVolume::maxLevel, queues.raised[0]);
+				}
+			}
+		}
+	}
+
+	// Calls visit(neighbourIndex, neighbourCorner) for each side neighbour sharing a face corner of the chunk
+	template <typename Visit>
+	void ForSharedCorners(const Chunk& chunk, const glm::ivec3& corner, const std::array<const Chunk*, 4>& neighbours, Visit visit) {
+		int last = settings.chunkSize / chunk.lod.step;
+		const bool onSide[4] = {corner.x == 0, corner.x == last, corner.z == 0, corner.z == last};
+		for (int s = 0; s < 4; ++s){
+			if (!onSide[s] || !neighbours[s]) continue;
+			glm::ivec3 shared = corner;
+			if (s < 2) shared.x = last - corner.x;
+			else shared.z = last - corner.z;
+			visit(static_cast<size_t>(neighbours[s] - chunks.data()), shared);
+		}
+	}
+
+	// Resident chunks with the same step across the -X, +X, -Z and +Z faces, null where there is none
+	std::array<const Chunk*, 4> SideNeighbours(const Chunk& chunk) const {
+		static const glm::ivec2 sides[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+		std::array<const Chunk*, 4> neighbours{};
+		for (int i = 0; i < 4; ++i){
+			const Chunk* found = FindChunk(chunk.x + sides[i].x * settings.chunkSize, chunk.z + sides[i].y * settings.chunkSize);
+			if (found && found->lod.step == chunk.lod.step && found->light.Size() == chunk.light.Size()) neighbours[i] = found;
+		}
+		return neighbours;
+	}
+
+	// Light of mesh vertices, read half a cell out along their normal where the air is. Points past a
+	// side face are read from the chunk across it, so vertices the two chunks share get the same light.
+	void BakeLight(const Chunk& chunk, std::vector<TerrainVertex>& vertices) const {
+		if (chunk.light.empty()) return;
+		float step = static_cast<float>(chunk.lod.step);
+		float last = static_cast<float>(settings.chunkSize / chunk.lod.step);
+		std::array<const Chunk*, 4> neighbours = SideNeighbours(chunk);
+		for (TerrainVertex& vertex : vertices){
+			glm::vec3 point = vertex.position / step + OctahedralNormal::Unpack16(vertex.normal) * 0.5f;
+			const Chunk* source = &chunk;
+			if (point.x < 0.0f && neighbours[0]) {source = neighbours[0]; point.x += last;}
+			else if (point.x > last && neighbours[1]) {source = neighbours[1]; point.x -= last;}
+			else if (point.z < 0.0f && neighbours[2]) {source = neighbours[2]; point.z += last;}
+			else if (point.z > last && neighbours[3]) {source = neighbours[3]; point.z -= last;}
+			vertex.light = source->light.At(point);
+		}
+	}
+
+	// Brings the corners on the chunk's side faces level with the neighbours sharing them,
+	// the corners either side brightens are queued for its next flood fill
+	void ExchangeFaces(size_t chunkIndex, std::vector<LightQueues>& queues) {
+		Chunk& chunk = chunks[chunkIndex];
+		if (chunk.light.empty()) return;
+		int last = settings.chunkSize / chunk.lod.step;
+		int top = chunk.light.Size().y - 1;
+		static const glm::ivec2 sides[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+		std::array<const Chunk*, 4> neighbours = SideNeighbours(chunk);
+		for (int s = 0; s < 4; ++s){
+			if (!neighbours[s]) continue;
+			const glm::ivec2& side = sides[s];
+			size_t neighbourIndex = static_cast<size_t>(neighbours[s] - chunks.data());
+			Chunk& neighbour = chunks[neighbourIndex];
+
+			// The face is x = last on this side and x = 0 on the other, or the same along z
+			for (int along = 0; along <= last; ++along){
+				for (int y = 0; y <= top; ++y){
+					glm::ivec3 own = side.x != 0 ? glm::ivec3{side.x > 0 ? last : 0, y, along} : glm::ivec3{along, y, side.y > 0 ? last : 0};
+					glm::ivec3 other = own;
+					if (side.x != 0) other.x = last - own.x;
+					else other.z = last - own.z;
+					for (int c = 0; c < 2; ++c){
+						int level = std::max(chunk.light.Get(lightChannels[c], own), neighbour.light.Get(lightChannels[c], other));
+						chunk.light.Raise(lightChannels[c], own, level, queues[chunkIndex].raised[c]);
+						neighbour.light.Raise(lightChannels[c], other, level, queues[neighbourIndex].raised[c]);
+					}
+				}
+			}
+		}
+	}
+
+	// Light sources inside the chunk light the lattice corner nearest to them, a source
+	// buried in solid ground stays dark
+	void SeedLightSources(Chunk& chunk, std::vector<glm::ivec3>& queue) const {
+		for (const LightSource& source : lightSources) SeedLightSource(chunk, source, queue);
+	}
+
+	void SeedLightSource(Chunk& chunk, const LightSource& source, std::vector<glm::ivec3>& queue) const {
+		glm::ivec3 corner = SourceCorner(chunk, source);
+		if (chunk.light.Inside(corner)) chunk.light.Raise(LightVolume::Block, corner, source.level, queue);
+	}
+
+	// Lattice corner of the chunk nearest to a light source, it may lie outside the chunk
+	glm::ivec3 SourceCorner(const Chunk& chunk, const LightSource& source) const {
+		LatticeFrame frame = ChunkFrame(chunk);
+		return glm::ivec3(glm::round((source.position + 0.5f - glm::vec3(frame.base)) / static_cast<float>(frame.step)));
+	}
+
+	// Chunks whose lattice overlaps the world corner indices [low, high] in x and z
+	std::vector<size_t> ChunksIn(const glm::ivec3& low, const glm::ivec3& high) const {
+		std::vector<size_t> result;
+		for (size_t i = 0; i < chunks.size(); ++i){
+			LatticeFrame frame = ChunkFrame(chunks[i]);
+			int span = settings.chunkSize;
+			if (frame.base.x > high.x || frame.base.x + span < low.x) continue;
+			if (frame.base.z > high.z || frame.base.z + span < low.z) continue;
+			result.push_back(i);
+		}
+		return result;
+	}
+
+	// World corner index nearest to a position
+	static glm::ivec3 CornerIndex(const glm::vec3& position) {return glm::ivec3(glm::round(position + 0.5f));}
+
+// LIGHTING ///////////////////////////////////////////////////////////////////////
+
+// RAY QUERIES ////////////////////////////////////////////////////////////////////
+
+	// Density at a world position, trilinear between the corners of the resident chunk holding it,
+	// and its gradient per world unit when asked for. chunk caches the last chunk looked up,
+	// false when no chunk is resident there.
+	bool SampleWorldDensity(const glm::vec3& position, float& value, const Chunk*& chunk, glm::vec3* gradient = nullptr) const {
+		// Chunks lie chunkSize apart, on the grid of any resident one
+		glm::vec3 index = position + 0.5f;
+		const Chunk& reference = chunk ? *chunk : chunks.front();
+		int offset = (settings.chunkSize - 1) / 2;
+		int chunkX = reference.x + static_cast<int>(std::floor((index.x + offset - reference.x) / settings.chunkSize)) * settings.chunkSize;
+		int chunkZ = reference.z + static_cast<int>(std::floor((index.z + offset - reference.z) / settings.chunkSize)) * settings.chunkSize;
+		if (!chunk || chunk->x != chunkX || chunk->z != chunkZ) chunk = FindChunk(chunkX, chunkZ);
+		if (!chunk) return false;
+
+		LatticeFrame frame = ChunkFrame(*chunk);
+		int last = settings.chunkSize / frame.step, top = LayerCount(frame.step);
+		glm::vec3 local = glm::clamp((index - glm::vec3(frame.base)) / static_cast<float>(frame.step), glm::vec3(0.0f), glm::vec3(last, top, last));
+		glm::ivec3 low = glm::min(glm::ivec3(glm::floor(local)), glm::ivec3(last - 1, top - 1, last - 1));
+		glm::vec3 t = local - glm::vec3(low);
+		value = 0.0f;
+		glm::vec3 slope{0.0f};
+		for (int i = 0; i < 8; ++i){
+			glm::ivec3 offset{i & 1, (i >> 1) & 1, (i >> 2) & 1};
+			glm::vec3 weight = glm::mix(1.0f - t, t, glm::vec3(offset));
+			glm::vec3 sign = glm::vec3(offset) * 2.0f - 1.0f;
+			float density = chunk->GetDensity(low.x + offset.x, low.y + offset.y, low.z + offset.z);
+			value += density * weight.x * weight.y * weight.z;
+			slope += density * sign * glm::vec3(weight.y * weight.z, weight.x * weight.z, weight.x * weight.y);
+		}
+		if (gradient) *gradient = slope / static_cast<float>(frame.step);
+		return true;
+	}
+
+	// Fills in a hit at distance along the ray, the normal from central differences of the density
+	DensityHit DensityRayHit(const glm::vec3& origin, const glm::vec3& direction, float distance, const Chunk* chunk, DensityHit result) const {
+		result.hit = true;
+		result.distance = distance;
+		result.point = origin + direction * distance;
+		result.chunk = {chunk->x, chunk->z};
+		result.chunkIndex = static_cast<size_t>(chunk - chunks.data());
+
+		// A side without a resident chunk falls back to the hit itself
+		glm::vec3 gradient{0.0f};
+		const Chunk* cached = chunk;
+		for (int axis = 0; axis < 3; ++axis){
+			glm::vec3 offset{0.0f};
+			offset[axis] = 0.5f;
+			float above = settings.isoLevel, below = settings.isoLevel;
+			SampleWorldDensity(result.point + offset, above, cached);
+			SampleWorldDensity(result.point - offset, below, cached);
+			gradient[axis] = above - below;
+		}
+		float length = glm::length(gradient);
+		result.normal = length > 0.0f ? -gradient / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		return result;
+	}
+// RAY QUERIES ////////////////////////////////////////////////////////////////////
+
+// LEVEL OF DETAIL /////////////////////////////////////////////////////////////////
+	// Lattice spacing doubles every lodRingChunks rings of chunks around the player's chunk.
+	// Only marching cubes conforms and stitches the seams between spacings, the padded meshers
+	// keep every chunk at full detail and leave the distance to the horizon.
+	int GetLodStep(int worldX, int worldZ, int centerX, int centerZ) const {
+		if (PaddedMeshing()) return 1;
+		int ring = std::max(std::abs(worldX - centerX), std::abs(worldZ - centerZ)) / settings.chunkSize;
+		int level = std::min(std::max(settings.lodLevels, 1) - 1, ring / std::max(settings.lodRingChunks, 1));
+		int step = 1 << level;
+
+		// Chunk edges have to land on the coarse lattice
+		while (step > 1 && settings.chunkSize % step != 0) step /= 2;
+		return step;
+	}
+
+	ChunkLod GetChunkLod(int worldX, int worldZ, int centerX, int centerZ) const {
+		auto stepAt = [&](int dx, int dz) {return GetLodStep(worldX + dx * settings.chunkSize, worldZ + dz * settings.chunkSize, centerX, centerZ);};
+		const int faces[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+		const int corners[4][2] = {{-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+
+		ChunkLod lod;
+		lod.step = stepAt(0, 0);
+		for (int i = 0; i < 4; ++i){
+			lod.faceSteps[i] = std::max(lod.step, stepAt(faces[i][0], faces[i][1]));
+			int cx = corners[i][0], cz = corners[i][1];
+			lod.cornerSteps[i] = std::max({lod.step, stepAt(cx, 0), stepAt(0, cz), stepAt(cx, cz)});
+		}
+		return lod;
+	}
+
+	// Lattice (x, z) of column u along a face, faces are -X, +X, -Z, +Z
+	static glm::ivec2 FaceColumn(int face, int u, int last) {
+		switch (face){
+			case 0: return {0, u};
+			case 1: return {last, u};
+			case 2: return {u, 0};
+			default: return {u, last};
+		}
+	}
+
+	// A corner column as all 4 chunks around it see it, linear between corners of the coarsest one
+	float ColumnDensity(const LatticeFrame& frame, const ChunkLod& lod, int x, int y, int z, int last) {
+		int corner = (x == last ? 1 : 0) | (z == last ? 2 : 0);
+		int ratio = lod.cornerSteps[corner] / lod.step;
+		int y0 = (y / ratio) * ratio;
+		if (y0 == y) return StoredDensity(frame, x, y, z);
+		float t = static_cast<float>(y - y0) / ratio;
+		return QuantiseDensity(glm::mix(StoredDensity(frame, x, y0, z), StoredDensity(frame, x, y0 + ratio, z), t));
+	}
+
+	// A coarse corner of a conformed face, the end columns as conformed below
+	float CoarseFaceDensity(const LatticeFrame& frame, const ChunkLod& lod, int face, int u, int y, int last) {
+		glm::ivec2 column = FaceColumn(face, u, last);
+		if (u == 0 || u == last) return ColumnDensity(frame, lod, column.x, y, column.y, last);
+		return StoredDensity(frame, column.x, y, column.y);
+	}
+
+	// Overwrites the faces and corner columns this chunk shares with coarser chunks.
+	// Corners on the coarse lattice take the density as the coarse chunk stores it and the fine
+	// corners between them are interpolated, so every crossing on a coarse edge lands where the
+	// coarse chunk puts it, up to the quantisation of the fine corners.
+	void ConformSeams(const LatticeFrame& frame, const ChunkLod& lod, ChunkDensity& density) {
+		int last = density.sizeX - 1;
+		int top = density.sizeY - 1;
+
+		for (int corner = 0; corner < 4; ++corner){
+			if (lod.cornerSteps[corner] <= lod.step) continue;
+			int x = (corner & 1) ? last : 0;
+			int z = (corner & 2) ? last : 0;
+			for (int y = 0; y <= top; ++y) density.set(x, y, z, ColumnDensity(frame, lod, x, y, z, last));
+		}
+
+		for (int face = 0; face < 4; ++face){
+			if (lod.faceSteps[face] <= lod.step) continue;
+			int ratio = lod.faceSteps[face] / lod.step;
+
+			// Coarse corners of the face, the end columns as conformed above
+			int coarseU = last / ratio + 1;
+			int coarseY = (top + ratio - 1) / ratio + 1;
+			std::vector<float> coarse(coarseU * coarseY);
+			for (int i = 0; i < coarseU; ++i){
+				for (int j = 0; j < coarseY; ++j) coarse[i * coarseY + j] = CoarseFaceDensity(frame, lod, face, i * ratio, j * ratio, last);
+			}
+
+			for (int u = 1; u < last; ++u){
+				glm::ivec2 column = FaceColumn(face, u, last);
+				int i = u / ratio;
+				float tu = static_cast<float>(u - i * ratio) / ratio;
+				for (int y = 0; y <= top; ++y){
+					int j = y / ratio;
+					float ty = static_cast<float>(y - j * ratio) / ratio;
+					float low = glm::mix(coarse[i * coarseY + j], coarse[(i + 1) * coarseY + j], tu);
+					float high = ty > 0.0f ? glm::mix(coarse[i * coarseY + j + 1], coarse[(i + 1) * coarseY + j + 1], tu) : low;
+					density.set(column.x, y, column.y, glm::mix(low, high, ty));
+				}
+			}
+		}
+	}
+
+	// Closes the sliver between this chunk's contour on a conformed face, which bends through the
+	// fine corners, and the straight contour the coarser neighbour draws across each of its face cells.
+	// Both end on the same coarse edge crossings, so a planar fan from one of them over the fine
+	// segments covers the gap. A saddle cell, crossed on all 4 edges, has two contours on each side.
+	// When both sides join the crossings the same way each pair is fanned like a plain cell, otherwise
+	// the fine and coarse contours go round the cell centre together and are fanned from there.
+	void StitchSeams(const LatticeFrame& frame, const ChunkLod& lod, const ChunkDensity& density, std::vector<TerrainVertex>& vertices) {
+		int last = density.sizeX - 1;
+		int top = density.sizeY - 1;
+		float step = static_cast<float>(lod.step);
+
+		for (int face = 0; face < 4; ++face){
+			if (lod.faceSteps[face] <= lod.step) continue;
+			int ratio = lod.faceSteps[face] / lod.step;
+			static const glm::ivec2 outwards[4] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+			glm::ivec2 outward = outwards[face];
+
+			auto value = [&](const glm::vec2& p) {
+				glm::ivec2 column = FaceColumn(face, static_cast<int>(p.x), last);
+				return density.get(column.x, static_cast<int>(p.y), column.y);
+			};
+			auto position = [&](const glm::vec2& p) {
+				float side = (face & 1) ? static_cast<float>(last) : 0.0f;
+				return (face < 2 ? glm::vec3{side, p.y, p.x} : glm::vec3{p.x, p.y, side}) * step;
+			};
+
+			for (int cu = 0; cu < last; cu += ratio){
+				for (int cy = 0; cy + ratio <= top; cy += ratio){
+					glm::vec2 cell[4] = {{cu, cy}, {cu + ratio, cy}, {cu + ratio, cy + ratio}, {cu, cy + ratio}};
+					float cellValues[4];
+					for (int k = 0; k < 4; ++k) cellValues[k] = CoarseFaceDensity(frame, lod, face, static_cast<int>(cell[k].x), static_cast<int>(cell[k].y), last);
+					glm::vec2 ends[4];
+					int crossings = SquareCrossings(cell, cellValues, settings.isoLevel, ends);
+					if (crossings != 2 && crossings != 4) continue;
+
+					// Density increases into the ground, the surface faces down the gradient
+					glm::vec2 gradient{cellValues[1] + cellValues[2] - cellValues[0] - cellValues[3], cellValues[2] + cellValues[3] - cellValues[0] - cellValues[1]};
+					glm::vec3 normal = face < 2 ? glm::vec3{0.0f, -gradient.y, -gradient.x} : glm::vec3{-gradient.x, -gradient.y, 0.0f};
+					normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3{0.0f, 1.0f, 0.0f};
+					uint32_t front = OctahedralNormal::Pack16(normal);
+					uint32_t back = OctahedralNormal::Pack16(-normal);
+
+					// The patch is seen from either side of the face, segments in line with the anchor leave nothing to close
+					auto fan = [&](const glm::vec2& anchor, const glm::vec2& from, const glm::vec2& to) {
+						glm::vec2 toA = from - anchor;
+						glm::vec2 toB = to - anchor;
+						if (std::abs(toA.x * toB.y - toA.y * toB.x) < 1e-5f) return;
+						glm::vec3 a = position(anchor), b = position(from), c = position(to);
+						vertices.push_back({a, front});
+						vertices.push_back({b, front});
+						vertices.push_back({c, front});
+						vertices.push_back({a, back});
+						vertices.push_back({c, back});
+						vertices.push_back({b, back});
+						generationStats.stitchTriangles += 2;
+					};
+
+					// Fine contour segments inside the cell, a fine saddle square joins them as marching cubes does
+					std::vector<glm::vec2> segments;
+					for (int u = cu; u < cu + ratio; ++u){
+						for (int y = cy; y < cy + ratio; ++y){
+							glm::vec2 square[4] = {{u, y}, {u + 1, y}, {u + 1, y + 1}, {u, y + 1}};
+							float squareValues[4];
+							for (int k = 0; k < 4; ++k) squareValues[k] = value(square[k]);
+							glm::vec2 points[4];
+							int count = SquareCrossings(square, squareValues, settings.isoLevel, points);
+							if (count == 2) segments.insert(segments.end(), {points[0], points[1]});
+							if (count != 4) continue;
+
+							float behind[4];
+							for (int k = 0; k < 4; ++k){
+								glm::ivec2 column = FaceColumn(face, static_cast<int>(square[k].x), last) - outward;
+								behind[k] = density.get(column.x, static_cast<int>(square[k].y), column.y);
+							}
+							if (FaceJoin(face, (face & 1) != 0, squareValues, behind) == 1) segments.insert(segments.end(), {points[0], points[1], points[2], points[3]});
+							else segments.insert(segments.end(), {points[1], points[2], points[3], points[0]});
+						}
+					}
+
+					// The fine corners are quantised after interpolation, so a fine contour ends a hair away from
+					// the coarse crossing, the sliver between them is closed from the same anchor as the contour
+					auto nearest = [&](const glm::vec2& end) {
+						size_t best = 0;
+						for (size_t i = 1; i < segments.size(); ++i) if (glm::distance(segments[i], end) < glm::distance(segments[best], end)) best = i;
+						return best;
+					};
+					if (segments.empty()) continue;
+
+					if (crossings == 2){
+						for (size_t i = 0; i < segments.size(); i += 2) fan(ends[0], segments[i], segments[i + 1]);
+						fan(ends[0], segments[nearest(ends[1])], ends[1]);
+						continue;
+					}
+
+					// Segments sharing an end belong to the same fine contour, each contour runs between two coarse crossings
+					std::vector<int> contour(segments.size() / 2);
+					for (size_t i = 0; i < contour.size(); ++i) contour[i] = static_cast<int>(i);
+					auto meets = [](const glm::vec2& a, const glm::vec2& b) {return glm::distance(a, b) < 1e-3f;};
+					for (bool merged = true; merged;){
+						merged = false;
+						for (size_t i = 0; i < contour.size(); ++i){
+							for (size_t j = i + 1; j < contour.size(); ++j){
+								if (contour[i] == contour[j]) continue;
+								const glm::vec2* a = &segments[i * 2];
+								const glm::vec2* b = &segments[j * 2];
+								if (!meets(a[0], b[0]) && !meets(a[0], b[1]) && !meets(a[1], b[0]) && !meets(a[1], b[1])) continue;
+								int low = std::min(contour[i], contour[j]);
+								for (int& c : contour) if (c == contour[i] || c == contour[j]) c = low;
+								merged = true;
+							}
+						}
+					}
+					auto contourAt = [&](const glm::vec2& end) {return contour[nearest(end) / 2];};
+					auto anchorOf = [&](int c) {
+						for (int k = 0; k < crossings; ++k) if (contourAt(ends[k]) == c) return k;
+						return 0;
+					};
+
+					int fineJoin = contourAt(ends[0]) == contourAt(ends[1]) ? 1 : 0;
+
+					// The coarse cube behind the cell lies outside this chunk, its far corners are sampled
+					float behind[4];
+					for (int k = 0; k < 4; ++k){
+						glm::ivec2 column = FaceColumn(face, static_cast<int>(cell[k].x), last) + outward * ratio;
+						behind[k] = StoredDensity(frame, column.x, static_cast<int>(cell[k].y), column.y);
+					}
+					int coarseJoin = FaceJoin(face, (face & 1) == 0, cellValues, behind);
+
+					if (coarseJoin != fineJoin){
+						glm::vec2 centre = (cell[0] + cell[2]) * 0.5f;
+						for (size_t i = 0; i < segments.size(); i += 2) fan(centre, segments[i], segments[i + 1]);
+						for (const glm::vec2& end : ends) fan(centre, segments[nearest(end)], end);
+						if (coarseJoin == 1){
+							fan(centre, ends[0], ends[1]);
+							fan(centre, ends[2], ends[3]);
+						}
+						else {
+							fan(centre, ends[1], ends[2]);
+							fan(centre, ends[3], ends[0]);
+						}
+						continue;
+					}
+
+					for (size_t i = 0; i < contour.size(); ++i) fan(ends[anchorOf(contour[i])], segments[i * 2], segments[i * 2 + 1]);
+					for (int k = 0; k < crossings; ++k){
+						int anchor = anchorOf(contourAt(ends[k]));
+						if (anchor != k) fan(ends[anchor], segments[nearest(ends[k])], ends[k]);
+					}
+				}
+			}
+		}
+	}
+
+	// How marching cubes joins the crossings of a face square crossed on all 4 edges, given the square
+	// and the corners of the cube behind it. 1 when its contours cut off corners 1 and 3, 0 for corners
+	// 0 and 2. farSide puts the square on the cube's high side of the face axis.
+	int FaceJoin(int face, bool farSide, const float squareValues[4], const float behindValues[4]) const {
+		static const int squareCorners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+		ChunkDensity cube(2, 2, 2);
+		int side = farSide ? 1 : 0;
+		for (int k = 0; k < 4; ++k){
+			int u = squareCorners[k][0], y = squareCorners[k][1];
+			if (face < 2){
+				cube.set(side, y, u, squareValues[k]);
+				cube.set(1 - side, y, u, behindValues[k]);
+			}
+			else {
+				cube.set(u, y, side, squareValues[k]);
+				cube.set(u, y, 1 - side, behindValues[k]);
+			}
+		}
+
+		// A triangle edge lying in the square's plane is one of the contours, the square edges it joins name the corner it cuts off
+		std::vector<TerrainVertex> triangles;
+		MarchingCubes::PolygoniseCube(cube, settings, 0, 0, 0, triangles);
+		auto squareEdge = [&](const glm::vec3& p) {
+			glm::vec2 q = face < 2 ? glm::vec2{p.z, p.y} : glm::vec2{p.x, p.y};
+			if (q.y < 1e-4f) return 0;
+			if (q.x > 1.0f - 1e-4f) return 1;
+			if (q.y > 1.0f - 1e-4f) return 2;
+			return 3;
+		};
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3){
+			for (int e = 0; e < 3; ++e){
+				const glm::vec3& a = triangles[i + e].position;
+				const glm::vec3& b = triangles[i + (e + 1) % 3].position;
+				float depthA = face < 2 ? a.x : a.z, depthB = face < 2 ? b.x : b.z;
+				if (std::abs(depthA - side) > 1e-4f || std::abs(depthB - side) > 1e-4f) continue;
+				int edges = 1 << squareEdge(a) | 1 << squareEdge(b);
+				return edges == 0b0011 || edges == 0b1100 ? 1 : 0;
+			}
+		}
+		return 1;
+	}
+
+	// Iso crossings on the edges of a face square whose corners go round in order, returns how many
+	static int SquareCrossings(const glm::vec2 corners[4], const float values[4], float isoLevel, glm::vec2 points[4]) {
+		int count = 0;
+		for (int a = 0; a < 4; ++a){
+			int b = (a + 1) % 4;
+			if ((values[a] < isoLevel) == (values[b] < isoLevel)) continue;
+			float t = (isoLevel - values[a]) / (values[b] - values[a]);
+			points[count++] = glm::mix(corners[a], corners[b], t);
+		}
+		return count;
+	}
+// LEVEL OF DETAIL /////////////////////////////////////////////////////////////////
+
 // NOISE GENERATION ////////////////////////////////////////////////////////////////
 	float GetNoise3D(float x, float y, float z){
 		float totalNoise = 0.0f;
@@ -242,11 +1968,62 @@ private:
 		return (totalNoise + 1)/2.0f;
 	}
 
+	float GetSurfaceHeight(float x, float z) {
+		return settings.surfaceHeight + GetNoise2D(x, z) * settings.surfaceNoiseStrength;
+	}
+
+	// Solid below the heightmap surface, minus the caves carved by the 3D noise
+	float GetDensity(float x, float y, float z, float surfaceY) {
+		return CombineDensity(y, surfaceY, GetNoise3D(x, y, z));
+	}
+
+	float CombineDensity(float y, float surfaceY, float caveNoise) {
+		float surfaceDensity = settings.isoLevel + (surfaceY - y);
+		float density = std::min(surfaceDensity, caveNoise);
+		return glm::clamp(density, 0.0f, 1.0f);
+	}
+
+	// Coarse levels of detail already space their corners further apart than the cave grid would
+	bool UpsampleCaves(const LatticeFrame& frame) const {
+		return caveDecimation > 1 && frame.step == 1;
+	}
+
+	// Cave noise at a lattice corner, upsampled from the section's coarse grid when decimated.
+	// The grid works in world lattice indices so neighbouring chunks share its points.
+	float CaveNoise(const LatticeFrame& frame, int x, int y, int z) {
+		auto sampleNoise = [&](int wx, int wy, int wz) {
+			generationStats.caveNoiseSamples++;
+			glm::vec3 position = LatticeFrame::Position({wx, wy, wz});
+			return GetNoise3D(position.x, position.y, position.z);
+		};
+		glm::ivec3 index = frame.Index(x, y, z);
+		if (UpsampleCaves(frame)) return caveGrid.Sample(index.x, index.y, index.z, sampleNoise);
+		return sampleNoise(index.x, index.y, index.z);
+	}
+
+	// Full resolution density at a lattice corner, what a chunk of any detail samples there
+	float ExactDensity(const LatticeFrame& frame, int x, int y, int z) {
+		glm::vec3 corner = frame.Corner(x, y, z);
+		generationStats.caveNoiseSamples++;
+		return GetDensity(corner.x, corner.y, corner.z, GetSurfaceHeight(corner.x, corner.z));
+	}
+
+	// The exact density as a chunk's sections keep it wherever it decides the surface
+	float StoredDensity(const LatticeFrame& frame, int x, int y, int z) {
+		return QuantiseDensity(ExactDensity(frame, x, y, z));
+	}
+
+	float QuantiseDensity(float value) const {
+		return CompressedDensity::QuantiseLiteral(value, settings.isoLevel, DensityPrecision());
+	}
+
 	void InitNoiseGenerator(){
       noiseGenerator3D.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
       noiseGenerator2D.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
       noiseGenerator3D.SetSeed(settings.seed);
       noiseGenerator2D.SetSeed(settings.seed);
+      noiseGenerator3D.SetFrequency(noiseFrequency);
+      noiseGenerator2D.SetFrequency(noiseFrequency);
 	}
 // NOISE GENERATION ////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,48 @@
+#ifndef TERRAIN_BRUSH_H
+#define TERRAIN_BRUSH_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include <cstdint>
+#include <algorithm>
+
+namespace Engine{
+
+// Dig or place brush for Terrain::Edit.
+// The shape's signed distance maps to density the same way the heightmap surface
+// does, isoLevel on the boundary and one unit of density per world unit.
+struct TerrainBrush{
+	enum class Shape : uint8_t { Sphere, Box };
+	enum class Mode : uint8_t { Add, Subtract };
+
+	Shape shape = Shape::Sphere;
+	Mode mode = Mode::Subtract;
+	glm::vec3 centre{0.0f};
+	glm::vec3 extent{1.0f}; // radius in x for spheres, half size for boxes
+	float strength = 1.0f; // 0 to 1, how far each application moves towards the shape
+
+	// Distance outside the shape, negative inside
+	float SignedDistance(const glm::vec3& position) const {
+		if (shape == Shape::Sphere) return glm::length(position - centre) - extent.x;
+		glm::vec3 q = glm::abs(position - centre) - extent;
+		return glm::length(glm::max(q, 0.0f)) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+	}
+
+	// Union with the shape when adding, difference when subtracting
+	float Apply(const glm::vec3& position, float density, float isoLevel) const {
+		float distance = SignedDistance(position);
+		float target = mode == Mode::Add ? std::max(density, isoLevel - distance) : std::min(density, isoLevel + distance);
+		return glm::clamp(glm::mix(density, target, strength), 0.0f, 1.0f);
+	}
+
+	// Apply leaves density in [0, 1] unchanged outside this box
+	void Bounds(glm::vec3& min, glm::vec3& max) const {
+		glm::vec3 reach = (shape == Shape::Sphere ? glm::vec3(extent.x) : extent) + 1.0f;
+		min = centre - reach;
+		max = centre + reach;
+	}
+};
+
+} // namespace
+#endif
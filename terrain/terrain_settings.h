@@ -0,0 +1,95 @@
+#ifndef TERRAIN_SETTINGS_H
+#define TERRAIN_SETTINGS_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "../vendor/glm/glm.hpp"
+#include <cstdint>
+#include <cstring>
+
+namespace Engine{
+
+// How chunk densities become triangles, see marching_cubes.h, dual_mesher.h and greedy_mesher.h
+enum class TerrainMesher : uint8_t {MarchingCubes, SurfaceNets, DualContouring, Blocks};
+
+struct TerrainSettings{
+	float isoLevel = 0.34f;
+
+	// World Settings
+	int worldHeight = 30;
+	int surfaceHeight = 5;
+	int chunkSize = 10;
+
+
+	// Noise Settings
+	int seed = 31584;
+	int octaves = 3;
+	float prominance = 0.5f;
+	float caveNoiseScale = 0.2f;
+	float surfaceNoiseScale = 1.0f;
+	float surfaceNoiseStrength = 25.0f;
+	int caveNoiseDecimation = 1; // cave noise every 1, 2 or 4 corners then trilinear, 0 picks one with the error metric
+
+	// Storage Settings
+	int sectionHeight = 16; // cubes per vertical chunk section
+	int densityPrecisionBits = 16; // 8 or 16, resident surface band quantisation
+	int editBlockCells = 8; // cells per side of the mesh blocks an edit re-meshes
+
+	// Mesh Settings
+	TerrainMesher mesher = TerrainMesher::MarchingCubes; // only marching cubes closes the seams between levels of detail, the others mesh every chunk at full detail
+	int occlusionRadius = 3; // lattice corners around a vertex that bake its ambient occlusion, 0 for none
+
+	// Level of Detail Settings
+	int lodLevels = 4; // lattice spacing 1, 2, 4, 8 world units, marching cubes only
+	int lodRingChunks = 3; // chunks per ring around the player before the spacing doubles
+
+	// Horizon Settings
+	int horizonLevels = 5; // clipmap levels past the chunk range, 0 disables the horizon
+	int horizonRingCells = 16; // cells from a level's centre to its edge
+	float horizonSinkDepth = 2.0f; // keeps the horizon under the chunks where they overlap
+
+	// Material Settings, evaluated by the terrain shaders so changes need no re-meshing
+    float snowMinHeightPercent = 0.9f;
+    float snowMaxAngle = 55.0f;
+    float grassMaxAngle = 45.0f;
+    glm::vec3 snowColour;
+    glm::vec3 grassColour;
+    glm::vec3 stoneColour;
+
+    TerrainSettings() {
+        snowColour = glm::vec3(1.0f, 1.0f, 1.0f);
+        grassColour = glm::vec3(0.45f, 0.62f, 0.2f);
+        stoneColour = glm::vec3(0.3f, 0.3f, 0.3f);
+    }
+
+    // FNV-1a over every setting that changes generated chunks.
+    // Cached chunks are only valid for the exact settings they were generated with.
+    uint64_t hash() const {
+    	uint64_t h = 14695981039346656037ull;
+    	auto mix = [&h](const void* data, size_t size){
+    		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    		for (size_t i = 0; i < size; ++i){
+    			h ^= bytes[i];
+    			h *= 1099511628211ull;
+    		}
+    	};
+    	mix(&isoLevel, sizeof(isoLevel));
+    	mix(&worldHeight, sizeof(worldHeight));
+    	mix(&surfaceHeight, sizeof(surfaceHeight));
+    	mix(&chunkSize, sizeof(chunkSize));
+    	mix(&seed, sizeof(seed));
+    	mix(&octaves, sizeof(octaves));
+    	mix(&prominance, sizeof(prominance));
+    	mix(&caveNoiseScale, sizeof(caveNoiseScale));
+    	mix(&surfaceNoiseScale, sizeof(surfaceNoiseScale));
+    	mix(&surfaceNoiseStrength, sizeof(surfaceNoiseStrength));
+    	mix(&caveNoiseDecimation, sizeof(caveNoiseDecimation));
+    	mix(&mesher, sizeof(mesher));
+    	mix(&occlusionRadius, sizeof(occlusionRadius));
+    	mix(&densityPrecisionBits, sizeof(densityPrecisionBits));
+    	return h;
+    }
+};
+
+} // namespace
+#endif
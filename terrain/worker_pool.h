@@ -0,0 +1,98 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+namespace Engine{
+
+// Threads started once and kept waiting for work, so a parallel loop costs a wake up
+// rather than a thread start per call. The calling thread takes a share of every loop.
+// One loop runs at a time, ParallelFor is not reentrant.
+class WorkerPool{
+public:
+	// One thread short of the hardware, the caller is the last
+	explicit WorkerPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1) {
+		for (size_t t = 0; t < threadCount; ++t) threads.emplace_back([this]() {WorkerLoop();});
+	}
+
+	~WorkerPool(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopWorkers = true;
+		}
+		workCondition.notify_all();
+		for (std::thread& thread : threads) thread.join();
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	size_t ThreadCount() const {return threads.size() + 1;}
+
+	// Runs work(0) to work(count - 1) over the pool, returns when all of them have
+	template <typename Work>
+	void ParallelFor(size_t count, Work work) {
+		if (threads.empty() || count <= 1){
+			for (size_t i = 0; i < count; ++i) work(i);
+			return;
+		}
+		std::function<void(size_t)> function = work;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = &function;
+			taskCount = count;
+			next = 0;
+			busy = threads.size();
+			generation++;
+		}
+		workCondition.notify_all();
+		Run();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this]() {return busy == 0;});
+		task = nullptr;
+	}
+
+private:
+	void Run() {
+		for (size_t i = next++; i < taskCount; i = next++) (*task)(i);
+	}
+
+	void WorkerLoop() {
+		uint64_t seen = 0;
+		while (true){
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				workCondition.wait(lock, [&]() {return stopWorkers || generation != seen;});
+				if (stopWorkers) return;
+				seen = generation;
+			}
+			Run();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--busy == 0) doneCondition.notify_all();
+			}
+		}
+	}
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workCondition;
+	std::condition_variable doneCondition;
+	const std::function<void(size_t)>* task = nullptr;
+	size_t taskCount = 0;
+	std::atomic<size_t> next{0};
+	size_t busy = 0;
+	uint64_t generation = 0;
+	bool stopWorkers = false;
+};
+
+} // namespace
+#endif